@@ -1,4 +1,4 @@
-QT += core gui widgets
+QT += core gui widgets concurrent
 
 TARGET = ScreenshotTool
 TEMPLATE = app
@@ -13,14 +13,71 @@ SOURCES += \
     main.cpp \
     screenshottool.cpp \
     regionselector.cpp \
-    imageeditor.cpp
+    imageeditor.cpp \
+    annotationlayer.cpp \
+    blurengine.cpp \
+    blurkernels.cpp \
+    clipboarddata.cpp \
+    savequeue.cpp \
+    pngencoder.cpp \
+    qoicodec.cpp \
+    imagebuffer.cpp \
+    imagepyramid.cpp \
+    profiler.cpp \
+    capturesource.cpp \
+    screencapture.cpp \
+    commandline.cpp \
+    burstcapture.cpp \
+    burstpicker.cpp \
+    capturestore.cpp \
+    historystore.cpp \
+    perceptualhash.cpp \
+    historygallery.cpp \
+    undohistory.cpp
 
 HEADERS += \
     screenshottool.h \
     regionselector.h \
     imageeditor.h \
+    annotationlayer.h \
+    blurengine.h \
+    blurkernels.h \
+    clipboarddata.h \
+    savequeue.h \
+    pngencoder.h \
+    qoicodec.h \
+    imagebuffer.h \
+    imagepyramid.h \
+    profiler.h \
+    capturesource.h \
+    screencapture.h \
+    commandline.h \
+    burstcapture.h \
+    burstpicker.h \
+    capturestore.h \
+    historystore.h \
+    perceptualhash.h \
+    historygallery.h \
+    undohistory.h \
     themes.h
 
+# zlib для параллельного PNG-кодера: на Windows встроенный в Qt (QtZlib),
+# на остальных системах системный
+win32: QT += zlib-private
+else: LIBS += -lz
+
+# Захват через X11 MIT-SHM (Linux): нужны libx11-dev и libxext-dev.
+# Без них остаётся захват через QScreen::grabWindow
+unix:!macx {
+    CONFIG += link_pkgconfig
+    packagesExist(x11 xext) {
+        PKGCONFIG += x11 xext
+        DEFINES += HAVE_XSHM
+        SOURCES += xshmcapturesource.cpp
+        HEADERS += xshmcapturesource.h
+    }
+}
+
 # Для 64-битной сборки
 win32 {
     CONFIG += windows  # Гарантирует правильную точку входа WinMain
@@ -0,0 +1,157 @@
+#include "annotationlayer.h"
+#include <QFontMetrics>
+#include <QPainter>
+#include <cmath>
+
+Annotation Annotation::arrow(const QPoint &from, const QPoint &to, const QColor &color, int thickness)
+{
+    Annotation annotation;
+    annotation.kind = Kind::Arrow;
+    annotation.from = from;
+    annotation.to = to;
+    annotation.color = color;
+    annotation.size = thickness;
+    annotation.bounds = arrowBounds(from, to, thickness);
+    return annotation;
+}
+
+Annotation Annotation::label(const QPoint &position, const QString &text, const QColor &color,
+                             int pointSize, QPaintDevice *device)
+{
+    Annotation annotation;
+    annotation.kind = Kind::Text;
+    annotation.from = position;
+    annotation.to = position;
+    annotation.text = text;
+    annotation.color = color;
+    annotation.size = pointSize;
+    annotation.bounds = textBounds(position, text, pointSize, device);
+    return annotation;
+}
+
+void Annotation::paint(QPainter &painter) const
+{
+    if (kind == Kind::Arrow)
+        paintArrow(painter, from, to, color, size);
+    else
+        paintText(painter, from, text, color, size);
+}
+
+void Annotation::translate(const QPoint &offset)
+{
+    from += offset;
+    to += offset;
+    bounds.translate(offset);
+}
+
+void Annotation::paintArrow(QPainter &painter, const QPoint &from, const QPoint &to,
+                            const QColor &color, int thickness)
+{
+    // Set pen for arrow
+    QPen pen(color, thickness);
+    pen.setCapStyle(Qt::RoundCap);
+    pen.setJoinStyle(Qt::RoundJoin);
+    painter.setPen(pen);
+    
+    // Draw the arrow line
+    painter.drawLine(from, to);
+    
+    // Draw arrowhead
+    double angle = std::atan2(static_cast<double>(to.y() - from.y()), 
+                              static_cast<double>(to.x() - from.x()));
+    
+    // Calculate arrowhead points
+    double headLength = 10 + thickness; // Make arrowhead size proportional to thickness
+    QPointF arrowP1 = to - QPointF(headLength * std::cos(angle - M_PI / 6), 
+                                   headLength * std::sin(angle - M_PI / 6));
+    QPointF arrowP2 = to - QPointF(headLength * std::cos(angle + M_PI / 6), 
+                                   headLength * std::sin(angle + M_PI / 6));
+    
+    painter.drawLine(to, arrowP1);
+    painter.drawLine(to, arrowP2);
+}
+
+void Annotation::paintText(QPainter &painter, const QPoint &position, const QString &text,
+                           const QColor &color, int pointSize)
+{
+    painter.setPen(QPen(color, 1)); // Text color
+    painter.setFont(QFont("Arial", pointSize));
+    painter.drawText(position, text);
+}
+
+QRect Annotation::arrowBounds(const QPoint &from, const QPoint &to, int thickness)
+{
+    // Line, round caps and the arrowhead (10 + thickness long)
+    const int margin = thickness + 10 + thickness;
+    return QRect(from, to).normalized().adjusted(-margin, -margin, margin, margin);
+}
+
+QRect Annotation::textBounds(const QPoint &position, const QString &text, int pointSize,
+                             QPaintDevice *device)
+{
+    const QFontMetrics metrics(QFont("Arial", pointSize), device);
+    const int margin = 2;
+    return metrics.boundingRect(text).translated(position).adjusted(-margin, -margin, margin, margin);
+}
+
+void AnnotationLayer::append(const Annotation &annotation)
+{
+    items.append(annotation);
+}
+
+void AnnotationLayer::clear()
+{
+    items.clear();
+}
+
+void AnnotationLayer::moveBy(int index, const QPoint &offset)
+{
+    items[index].translate(offset);
+}
+
+void AnnotationLayer::translate(const QPoint &offset)
+{
+    for (Annotation &annotation : items)
+        annotation.translate(offset);
+}
+
+int AnnotationLayer::hitTest(const QPoint &point) const
+{
+    for (int i = items.size() - 1; i >= 0; --i) {
+        if (items.at(i).bounds.contains(point))
+            return i;
+    }
+    return -1;
+}
+
+QRect AnnotationLayer::boundingRect() const
+{
+    QRect area;
+    for (const Annotation &annotation : items)
+        area |= annotation.bounds;
+    return area;
+}
+
+void AnnotationLayer::paint(QPainter &painter, const QRect &exposed) const
+{
+    if (items.isEmpty())
+        return;
+
+    painter.save();
+    for (const Annotation &annotation : items) {
+        if (exposed.isNull() || annotation.bounds.intersects(exposed))
+            annotation.paint(painter);
+    }
+    painter.restore();
+}
+
+ImageBuffer AnnotationLayer::flatten(const ImageBuffer &image) const
+{
+    if (items.isEmpty() || image.isNull())
+        return image;
+
+    ImageBuffer flattened = image;
+    QPainter painter(&flattened.edit());
+    paint(painter);
+    return flattened;
+}
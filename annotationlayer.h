@@ -0,0 +1,80 @@
+#ifndef ANNOTATIONLAYER_H
+#define ANNOTATIONLAYER_H
+
+#include <QColor>
+#include <QPoint>
+#include <QRect>
+#include <QString>
+#include <QVector>
+#include "imagebuffer.h"
+
+class QPainter;
+class QPaintDevice;
+
+// One arrow or text label kept as vector data on top of the image
+struct Annotation {
+    enum class Kind {
+        Arrow,
+        Text
+    };
+
+    Kind kind;
+    QPoint from;    // arrow start / text baseline position
+    QPoint to;      // arrow end
+    QString text;
+    QColor color;
+    int size;       // arrow thickness or text point size
+    QRect bounds;   // area touched when painted, in image coordinates
+
+    static Annotation arrow(const QPoint &from, const QPoint &to, const QColor &color, int thickness);
+    // 'device' supplies the resolution used to measure the text
+    static Annotation label(const QPoint &position, const QString &text, const QColor &color,
+                            int pointSize, QPaintDevice *device);
+
+    void paint(QPainter &painter) const;
+    void translate(const QPoint &offset);
+
+    // Rasterization shared by the annotation layer and the benchmarks
+    static void paintArrow(QPainter &painter, const QPoint &from, const QPoint &to,
+                           const QColor &color, int thickness);
+    static void paintText(QPainter &painter, const QPoint &position, const QString &text,
+                          const QColor &color, int pointSize);
+    static QRect arrowBounds(const QPoint &from, const QPoint &to, int thickness);
+    static QRect textBounds(const QPoint &position, const QString &text, int pointSize,
+                            QPaintDevice *device);
+};
+
+// Display list of annotations drawn over the base image. Adding or moving
+// an annotation costs in proportion to its own size; pixels are produced
+// only by flatten(), when the image leaves the editor.
+class AnnotationLayer
+{
+public:
+    bool isEmpty() const { return items.isEmpty(); }
+    int count() const { return items.size(); }
+    const Annotation &at(int index) const { return items.at(index); }
+
+    void append(const Annotation &annotation);
+    void clear();
+
+    // Moves one annotation, or all of them (e.g. after a crop)
+    void moveBy(int index, const QPoint &offset);
+    void translate(const QPoint &offset);
+
+    // Topmost annotation whose bounds contain 'point', or -1
+    int hitTest(const QPoint &point) const;
+
+    // Union of all annotation bounds
+    QRect boundingRect() const;
+
+    // Paints the annotations that intersect 'exposed' (all if null)
+    void paint(QPainter &painter, const QRect &exposed = QRect()) const;
+
+    // 'image' with every annotation burnt in; 'image' itself when empty
+    ImageBuffer flatten(const ImageBuffer &image) const;
+
+private:
+    QVector<Annotation> items;
+};
+
+#endif // ANNOTATIONLAYER_H
@@ -0,0 +1,40 @@
+#ifndef BENCHMARKMAIN_H
+#define BENCHMARKMAIN_H
+
+#include <QApplication>
+#include <QFileInfo>
+#include <QStringList>
+#include <QtTest>
+
+// Runs a QtTest benchmark object headless. Unless the caller passes its own
+// -o options, results go to stdout as text and to <binary>.xml, which keeps
+// every QBENCHMARK result machine-readable for comparison against a baseline.
+template <typename TestObject>
+int runBenchmark(int argc, char *argv[])
+{
+    if (!qEnvironmentVariableIsSet("QT_QPA_PLATFORM"))
+        qputenv("QT_QPA_PLATFORM", "offscreen");
+
+    QApplication app(argc, argv);
+
+    // QApplication has removed the Qt options (-platform etc.) from argv
+    QStringList args;
+    for (int i = 0; i < argc; ++i)
+        args << QString::fromLocal8Bit(argv[i]);
+
+    if (!args.contains("-o")) {
+        const QString name = QFileInfo(args.first()).completeBaseName();
+        args << "-o" << "-,txt" << "-o" << name + ".xml,xml";
+    }
+
+    TestObject test;
+    return QTest::qExec(&test, args);
+}
+
+#define BENCHMARK_MAIN(TestObject) \
+    int main(int argc, char *argv[]) \
+    { \
+        return runBenchmark<TestObject>(argc, argv); \
+    }
+
+#endif // BENCHMARKMAIN_H
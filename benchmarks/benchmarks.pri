@@ -0,0 +1,17 @@
+# Общие настройки бенчмарков: исходники приложения берутся из корня репозитория
+
+QT += core gui widgets concurrent testlib
+
+CONFIG += c++11 console release
+CONFIG -= app_bundle
+
+APP_ROOT = $$PWD/..
+INCLUDEPATH += $$APP_ROOT $$PWD
+
+HEADERS += \
+    $$PWD/benchmarkmain.h \
+    $$PWD/syntheticimage.h
+
+win32 {
+    QMAKE_CXXFLAGS += -Wno-deprecated-copy
+}
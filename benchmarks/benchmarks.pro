@@ -0,0 +1,15 @@
+# Микробенчмарки горячих путей (QtTest, QBENCHMARK).
+# Запуск без дисплея: платформа offscreen выбирается автоматически.
+#
+#   qmake benchmarks/benchmarks.pro && make
+#   ./benchmarks/imagebench/imagebench            # текст + imagebench.xml
+#   ./benchmarks/startupbench/startupbench        # холодный старт (нужна сборка ScreenshotTool.pro)
+#   xvfb-run -s "-screen 0 3840x2160x24" env QT_QPA_PLATFORM=xcb \
+#       ./benchmarks/capturebench/capturebench    # grabWindow против MIT-SHM
+
+TEMPLATE = subdirs
+
+SUBDIRS += \
+    imagebench \
+    startupbench \
+    capturebench
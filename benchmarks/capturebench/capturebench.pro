@@ -0,0 +1,29 @@
+include(../benchmarks.pri)
+
+TARGET = capturebench
+TEMPLATE = app
+
+# Запускать под X-сервером (Xvfb), см. benchmarks.pro. Без libx11/libxext
+# измеряется только бэкенд qt
+unix:!macx {
+    CONFIG += link_pkgconfig
+    packagesExist(x11 xext) {
+        PKGCONFIG += x11 xext
+        DEFINES += HAVE_XSHM
+        SOURCES += $$APP_ROOT/xshmcapturesource.cpp
+        HEADERS += $$APP_ROOT/xshmcapturesource.h
+    }
+}
+
+SOURCES += \
+    tst_capturebench.cpp \
+    $$APP_ROOT/capturesource.cpp \
+    $$APP_ROOT/screencapture.cpp \
+    $$APP_ROOT/imagebuffer.cpp \
+    $$APP_ROOT/profiler.cpp
+
+HEADERS += \
+    $$APP_ROOT/capturesource.h \
+    $$APP_ROOT/screencapture.h \
+    $$APP_ROOT/imagebuffer.h \
+    $$APP_ROOT/profiler.h
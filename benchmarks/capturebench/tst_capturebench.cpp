@@ -0,0 +1,84 @@
+#include "benchmarkmain.h"
+#include "capturesource.h"
+#include "screencapture.h"
+#include <QGuiApplication>
+#include <QScopedPointer>
+
+// Capture backends on a real X server, usually Xvfb (see benchmarks.pro):
+// QScreen::grabWindow against MIT-SHM, for the whole desktop and for a
+// small rectangle as grabbed by a region capture.
+class CaptureBench : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+    void cleanup();
+
+    void backendsAgree();
+    void grab_data();
+    void grab();
+};
+
+void CaptureBench::initTestCase()
+{
+    if (QGuiApplication::platformName() != "xcb")
+        QSKIP("Needs an X server: run under xvfb-run with QT_QPA_PLATFORM=xcb");
+}
+
+void CaptureBench::cleanup()
+{
+    ScreenCapture::setSource(nullptr);
+}
+
+// Both backends must return the same pixels for the same area
+void CaptureBench::backendsAgree()
+{
+    if (!ScreenCapture::backendNames().contains("xshm"))
+        QSKIP("Built without MIT-SHM support");
+
+    QScopedPointer<CaptureSource> qt(ScreenCapture::createSource("qt"));
+    QScopedPointer<CaptureSource> xshm(ScreenCapture::createSource("xshm"));
+    if (xshm.isNull())
+        QSKIP("MIT-SHM not available on this display");
+
+    const QRect area(64, 32, 300, 200);
+    ScreenCapture::setSource(qt.data());
+    const QImage expected = ScreenCapture::grab(area).image().convertToFormat(QImage::Format_RGB32);
+    ScreenCapture::setSource(xshm.data());
+    const QImage actual = ScreenCapture::grab(area).image().convertToFormat(QImage::Format_RGB32);
+    QCOMPARE(actual, expected);
+}
+
+void CaptureBench::grab_data()
+{
+    QTest::addColumn<QString>("backend");
+    QTest::addColumn<QRect>("area");
+
+    for (const QString &backend : ScreenCapture::backendNames()) {
+        if (backend == "synthetic")
+            continue;
+        QTest::addRow("%s full", qPrintable(backend)) << backend << QRect();
+        QTest::addRow("%s 256x256", qPrintable(backend)) << backend << QRect(100, 100, 256, 256);
+    }
+}
+
+void CaptureBench::grab()
+{
+    QFETCH(QString, backend);
+    QFETCH(QRect, area);
+
+    QScopedPointer<CaptureSource> source(ScreenCapture::createSource(backend));
+    if (source.isNull())
+        QSKIP("Backend not available on this display");
+    ScreenCapture::setSource(source.data());
+
+    QBENCHMARK {
+        const ImageBuffer image = ScreenCapture::grab(area);
+        QVERIFY(!image.isNull());
+    }
+}
+
+BENCHMARK_MAIN(CaptureBench)
+
+#include "tst_capturebench.moc"
@@ -0,0 +1,45 @@
+include(../benchmarks.pri)
+
+TARGET = imagebench
+TEMPLATE = app
+
+# zlib для pngencoder.cpp, как в ScreenshotTool.pro
+win32: QT += zlib-private
+else: LIBS += -lz
+
+SOURCES += \
+    tst_imagebench.cpp \
+    $$APP_ROOT/annotationlayer.cpp \
+    $$APP_ROOT/blurengine.cpp \
+    $$APP_ROOT/blurkernels.cpp \
+    $$APP_ROOT/clipboarddata.cpp \
+    $$APP_ROOT/imagebuffer.cpp \
+    $$APP_ROOT/imagepyramid.cpp \
+    $$APP_ROOT/pngencoder.cpp \
+    $$APP_ROOT/qoicodec.cpp \
+    $$APP_ROOT/savequeue.cpp \
+    $$APP_ROOT/undohistory.cpp \
+    $$APP_ROOT/capturesource.cpp \
+    $$APP_ROOT/capturestore.cpp \
+    $$APP_ROOT/historystore.cpp \
+    $$APP_ROOT/perceptualhash.cpp \
+    $$APP_ROOT/screencapture.cpp \
+    $$APP_ROOT/profiler.cpp
+
+HEADERS += \
+    $$APP_ROOT/annotationlayer.h \
+    $$APP_ROOT/blurengine.h \
+    $$APP_ROOT/blurkernels.h \
+    $$APP_ROOT/clipboarddata.h \
+    $$APP_ROOT/imagebuffer.h \
+    $$APP_ROOT/imagepyramid.h \
+    $$APP_ROOT/pngencoder.h \
+    $$APP_ROOT/qoicodec.h \
+    $$APP_ROOT/savequeue.h \
+    $$APP_ROOT/undohistory.h \
+    $$APP_ROOT/capturesource.h \
+    $$APP_ROOT/capturestore.h \
+    $$APP_ROOT/historystore.h \
+    $$APP_ROOT/perceptualhash.h \
+    $$APP_ROOT/screencapture.h \
+    $$APP_ROOT/profiler.h
@@ -0,0 +1,764 @@
+#include "benchmarkmain.h"
+#include "syntheticimage.h"
+#include "annotationlayer.h"
+#include "blurengine.h"
+#include "blurkernels.h"
+#include "capturesource.h"
+#include "capturestore.h"
+#include "clipboarddata.h"
+#include "historystore.h"
+#include "imagepyramid.h"
+#include "perceptualhash.h"
+#include "pngencoder.h"
+#include "qoicodec.h"
+#include "savequeue.h"
+#include "screencapture.h"
+#include "undohistory.h"
+#include <QBuffer>
+#include <QClipboard>
+#include <QFile>
+#include <QGuiApplication>
+#include <QHash>
+#include <QImageWriter>
+#include <QPixmap>
+#include <QTemporaryDir>
+
+Q_DECLARE_METATYPE(CaptureSource::Screen)
+
+// Hot paths of capture editing: blur, crop, preview scaling, annotation
+// rasterization and encoding, on synthetic 1080p / 4K / 8K captures.
+class ImageBench : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+    void cleanup();
+
+    void blur_data();
+    void blur();
+    void blurKernels_data();
+    void blurKernels();
+    void blurScaling_data();
+    void blurScaling();
+    void blurPreview_data();
+    void blurPreview();
+
+    void crop_data();
+    void crop();
+    void previewScale_data();
+    void previewScale();
+    void pyramidBuild_data();
+    void pyramidBuild();
+    void arrow_data();
+    void arrow();
+    void text_data();
+    void text();
+    void encode_data();
+    void encode();
+    void pngEncoder_data();
+    void pngEncoder();
+    void losslessEncode_data();
+    void losslessEncode();
+    void qoiDecode_data();
+    void qoiDecode();
+    void clipboardCopy_data();
+    void clipboardCopy();
+    void historyAppend_data();
+    void historyAppend();
+    void historyOpen();
+    void perceptualHash_data();
+    void perceptualHash();
+    void undoRedo_data();
+    void undoRedo();
+    void captureStoreAppend_data();
+    void captureStoreAppend();
+    void captureStoreRebuild_data();
+    void captureStoreRebuild();
+    void multiScreenCapture_data();
+    void multiScreenCapture();
+    void burstFrame_data();
+    void burstFrame();
+
+private:
+    void addResolutionRows();
+    QVector<QImage> desktopSequence(const QString &resolution) const;
+
+    QHash<QString, QImage> images;
+};
+
+void ImageBench::initTestCase()
+{
+    for (const Synthetic::Resolution &resolution : Synthetic::Resolutions)
+        images.insert(resolution.name, Synthetic::screenshot(QSize(resolution.width, resolution.height)));
+}
+
+void ImageBench::cleanup()
+{
+    BlurKernels::setActiveInstructionSet(BlurKernels::detectedInstructionSet());
+}
+
+void ImageBench::addResolutionRows()
+{
+    QTest::addColumn<QString>("resolution");
+    for (const Synthetic::Resolution &resolution : Synthetic::Resolutions)
+        QTest::newRow(resolution.name) << QString(resolution.name);
+}
+
+void ImageBench::blur_data()
+{
+    QTest::addColumn<QString>("resolution");
+    QTest::addColumn<int>("radius");
+    QTest::addColumn<int>("quality");
+
+    const int radii[] = { 1, 10, 25, 50 };
+    for (const Synthetic::Resolution &resolution : Synthetic::Resolutions) {
+        for (int radius : radii) {
+            QTest::addRow("%s r%d box", resolution.name, radius)
+                << QString(resolution.name) << radius << int(BlurEngine::Quality::Box);
+            QTest::addRow("%s r%d gaussian", resolution.name, radius)
+                << QString(resolution.name) << radius << int(BlurEngine::Quality::Gaussian);
+        }
+    }
+}
+
+// What ImageEditor::blurImage runs on the GUI thread
+void ImageBench::blur()
+{
+    QFETCH(QString, resolution);
+    QFETCH(int, radius);
+    QFETCH(int, quality);
+
+    const QImage source = images.value(resolution);
+    QBENCHMARK {
+        QImage work = source;
+        BlurEngine::blur(work, radius, BlurEngine::Quality(quality));
+    }
+}
+
+void ImageBench::blurKernels_data()
+{
+    QTest::addColumn<int>("instructionSet");
+    QTest::newRow("scalar") << int(BlurKernels::InstructionSet::Scalar);
+    QTest::newRow("sse2") << int(BlurKernels::InstructionSet::SSE2);
+    QTest::newRow("avx2") << int(BlurKernels::InstructionSet::AVX2);
+}
+
+void ImageBench::blurKernels()
+{
+    QFETCH(int, instructionSet);
+
+    const BlurKernels::InstructionSet set = BlurKernels::InstructionSet(instructionSet);
+    if (int(set) > int(BlurKernels::detectedInstructionSet()))
+        QSKIP("Instruction set not supported by this CPU");
+
+    const QImage source = images.value("4K");
+
+    // The vector kernels must reproduce the scalar result bit for bit
+    BlurKernels::setActiveInstructionSet(BlurKernels::InstructionSet::Scalar);
+    QImage expected = source;
+    BlurEngine::blur(expected, 10, BlurEngine::Quality::Gaussian);
+
+    BlurKernels::setActiveInstructionSet(set);
+    QImage actual = source;
+    BlurEngine::blur(actual, 10, BlurEngine::Quality::Gaussian);
+    QCOMPARE(actual, expected);
+
+    QBENCHMARK {
+        QImage work = source;
+        BlurEngine::blur(work, 10, BlurEngine::Quality::Gaussian);
+    }
+}
+
+void ImageBench::blurScaling_data()
+{
+    QTest::addColumn<QString>("resolution");
+    QTest::addColumn<int>("threads");
+
+    const int threadCounts[] = { 1, 2, 4, 8 };
+    for (const char *resolution : { "4K", "8K" }) {
+        for (int threads : threadCounts)
+            QTest::addRow("%s %d threads", resolution, threads) << QString(resolution) << threads;
+    }
+}
+
+// Scaling report for the tiled blur used by ImageEditor::applyBlur
+void ImageBench::blurScaling()
+{
+    QFETCH(QString, resolution);
+    QFETCH(int, threads);
+
+    const QImage source = images.value(resolution);
+
+    QImage expected = source;
+    BlurEngine::blur(expected, 50, BlurEngine::Quality::Gaussian);
+    QImage actual = source;
+    BlurEngine::blurParallel(actual, 50, BlurEngine::Quality::Gaussian, threads);
+    QCOMPARE(actual, expected);
+
+    QBENCHMARK {
+        QImage work = source;
+        BlurEngine::blurParallel(work, 50, BlurEngine::Quality::Gaussian, threads);
+    }
+}
+
+void ImageBench::blurPreview_data()
+{
+    addResolutionRows();
+}
+
+// Cache built when a Blur drag starts in ImageEditor; must fit in a few frames
+void ImageBench::blurPreview()
+{
+    QFETCH(QString, resolution);
+
+    const QImage source = images.value(resolution);
+    QBENCHMARK {
+        int scale = 1;
+        QImage preview = BlurEngine::blurPreview(source, 10, BlurEngine::Quality::Gaussian, &scale);
+        Q_UNUSED(preview)
+    }
+}
+
+void ImageBench::crop_data()
+{
+    addResolutionRows();
+}
+
+// RegionSelector / ImageEditor::applyCrop: copy of the central quarter
+void ImageBench::crop()
+{
+    QFETCH(QString, resolution);
+
+    const QPixmap source = QPixmap::fromImage(images.value(resolution));
+    const QRect region(source.width() / 4, source.height() / 4,
+                       source.width() / 2, source.height() / 2);
+    QBENCHMARK {
+        QPixmap cropped = source.copy(region);
+        Q_UNUSED(cropped)
+    }
+}
+
+void ImageBench::previewScale_data()
+{
+    QTest::addColumn<QString>("resolution");
+    QTest::addColumn<bool>("pyramid");
+
+    for (const Synthetic::Resolution &resolution : Synthetic::Resolutions) {
+        QTest::addRow("%s direct", resolution.name) << QString(resolution.name) << false;
+        QTest::addRow("%s pyramid", resolution.name) << QString(resolution.name) << true;
+    }
+}
+
+// ScreenshotTool::refreshPreview with the default 600x500 window: smooth
+// scaling from full resolution versus from the cached pyramid level
+void ImageBench::previewScale()
+{
+    QFETCH(QString, resolution);
+    QFETCH(bool, pyramid);
+
+    const QImage source = images.value(resolution);
+    const ImagePyramid levels{ImageBuffer(source)};
+    const QSize target = QSize(540, 400);
+    QBENCHMARK {
+        QImage preview = pyramid ? levels.scaled(target)
+                                 : source.scaled(target, Qt::KeepAspectRatio, Qt::SmoothTransformation);
+        Q_UNUSED(preview)
+    }
+}
+
+void ImageBench::pyramidBuild_data()
+{
+    addResolutionRows();
+}
+
+// Once per capture or edit: ScreenshotTool::setPreviewPixmap
+void ImageBench::pyramidBuild()
+{
+    QFETCH(QString, resolution);
+
+    const ImageBuffer source(images.value(resolution));
+    QBENCHMARK {
+        ImagePyramid pyramid(source);
+        Q_UNUSED(pyramid)
+    }
+}
+
+void ImageBench::arrow_data()
+{
+    addResolutionRows();
+}
+
+// Export of a frame with one arrow: AnnotationLayer::flatten
+void ImageBench::arrow()
+{
+    QFETCH(QString, resolution);
+
+    const ImageBuffer source(images.value(resolution));
+    AnnotationLayer layer;
+    layer.append(Annotation::arrow(QPoint(100, 100), QPoint(600, 400), Qt::red, 3));
+    QBENCHMARK {
+        ImageBuffer result = layer.flatten(source);
+        Q_UNUSED(result)
+    }
+}
+
+void ImageBench::text_data()
+{
+    addResolutionRows();
+}
+
+// Export of a frame with one line of text: AnnotationLayer::flatten
+void ImageBench::text()
+{
+    QFETCH(QString, resolution);
+
+    QImage image = images.value(resolution);
+    const ImageBuffer source(image);
+    AnnotationLayer layer;
+    layer.append(Annotation::label(QPoint(100, 100), "Annotation text", Qt::red, 19, &image));
+    QBENCHMARK {
+        ImageBuffer result = layer.flatten(source);
+        Q_UNUSED(result)
+    }
+}
+
+void ImageBench::encode_data()
+{
+    QTest::addColumn<QString>("resolution");
+    QTest::addColumn<QByteArray>("format");
+
+    for (const Synthetic::Resolution &resolution : Synthetic::Resolutions) {
+        QTest::addRow("%s png", resolution.name) << QString(resolution.name) << QByteArray("PNG");
+        QTest::addRow("%s jpg", resolution.name) << QString(resolution.name) << QByteArray("JPG");
+    }
+}
+
+// ScreenshotTool::onSave, encoding into memory to keep disk I/O out
+void ImageBench::encode()
+{
+    QFETCH(QString, resolution);
+    QFETCH(QByteArray, format);
+
+    const QPixmap source = QPixmap::fromImage(images.value(resolution));
+    QBENCHMARK {
+        QBuffer buffer;
+        buffer.open(QIODevice::WriteOnly);
+        QVERIFY(source.save(&buffer, format.constData()));
+    }
+}
+
+void ImageBench::pngEncoder_data()
+{
+    QTest::addColumn<QString>("resolution");
+    QTest::addColumn<bool>("parallel");
+    QTest::addColumn<int>("level");
+
+    const int levels[] = { PngEncoder::FastestLevel, PngEncoder::DefaultLevel, PngEncoder::SmallestLevel };
+    for (const Synthetic::Resolution &resolution : Synthetic::Resolutions) {
+        for (int level : levels) {
+            QTest::addRow("%s QImageWriter level %d", resolution.name, level)
+                << QString(resolution.name) << false << level;
+            QTest::addRow("%s parallel level %d", resolution.name, level)
+                << QString(resolution.name) << true << level;
+        }
+    }
+}
+
+// PngEncoder against QImageWriter at the same zlib level: time, file size,
+// and a lossless round trip
+void ImageBench::pngEncoder()
+{
+    QFETCH(QString, resolution);
+    QFETCH(bool, parallel);
+    QFETCH(int, level);
+
+    const QImage source = images.value(resolution).convertToFormat(QImage::Format_RGB32);
+    // QImageWriter's quality for a zlib level (inverse of levelForQuality)
+    const int quality = 100 - (level * 91 + 8) / 9;
+    QCOMPARE(PngEncoder::levelForQuality(quality), level);
+
+    QByteArray encoded;
+    QBENCHMARK {
+        QBuffer buffer(&encoded);
+        buffer.open(QIODevice::WriteOnly | QIODevice::Truncate);
+        if (parallel) {
+            QVERIFY(PngEncoder::write(source, &buffer, level));
+        } else {
+            QImageWriter writer(&buffer, "png");
+            writer.setQuality(quality);
+            QVERIFY(writer.write(source));
+        }
+    }
+
+    qDebug("%s %s level %d: %.2f MB", qPrintable(resolution),
+           parallel ? "parallel" : "QImageWriter", level, encoded.size() / 1048576.0);
+    QImage decoded;
+    QVERIFY(decoded.loadFromData(encoded, "png"));
+    QCOMPARE(decoded.convertToFormat(QImage::Format_RGB32), source);
+}
+
+void ImageBench::losslessEncode_data()
+{
+    QTest::addColumn<QString>("resolution");
+    QTest::addColumn<QByteArray>("format");
+
+    for (const Synthetic::Resolution &resolution : Synthetic::Resolutions) {
+        QTest::addRow("%s qoi", resolution.name) << QString(resolution.name) << QByteArray("qoi");
+        QTest::addRow("%s png", resolution.name) << QString(resolution.name) << QByteArray("png");
+    }
+}
+
+// SaveQueue::encode for the archive formats: QOI against PNG at the
+// default level, with the compression ratio against raw RGB
+void ImageBench::losslessEncode()
+{
+    QFETCH(QString, resolution);
+    QFETCH(QByteArray, format);
+
+    const QImage source = images.value(resolution).convertToFormat(QImage::Format_RGB32);
+    QByteArray encoded;
+    QBENCHMARK {
+        QBuffer buffer(&encoded);
+        buffer.open(QIODevice::WriteOnly | QIODevice::Truncate);
+        QVERIFY(SaveQueue::encode(source, &buffer, format, -1));
+    }
+
+    const qint64 raw = qint64(source.width()) * source.height() * 3;
+    qDebug("%s %s: %.2f MB, ratio %.1f", qPrintable(resolution), format.constData(),
+           encoded.size() / 1048576.0, double(raw) / encoded.size());
+}
+
+void ImageBench::qoiDecode_data()
+{
+    addResolutionRows();
+}
+
+void ImageBench::qoiDecode()
+{
+    QFETCH(QString, resolution);
+
+    const QImage source = images.value(resolution).convertToFormat(QImage::Format_RGB32);
+    QByteArray encoded;
+    QBuffer output(&encoded);
+    output.open(QIODevice::WriteOnly);
+    QVERIFY(QoiCodec::write(source, &output));
+
+    QImage decoded;
+    QBENCHMARK {
+        QBuffer input(&encoded);
+        input.open(QIODevice::ReadOnly);
+        decoded = QoiCodec::read(&input);
+    }
+    QCOMPARE(decoded, source);
+}
+
+void ImageBench::clipboardCopy_data()
+{
+    addResolutionRows();
+}
+
+// ScreenshotTool::onCopy: publishing must not encode anything; the first
+// paste of a format encodes it once
+void ImageBench::clipboardCopy()
+{
+    QFETCH(QString, resolution);
+
+    const QImage source = images.value(resolution).convertToFormat(QImage::Format_RGB32);
+    QClipboard *clipboard = QGuiApplication::clipboard();
+    QBENCHMARK {
+        clipboard->setMimeData(new ClipboardImageData(source));
+    }
+
+    const ClipboardImageData *published = qobject_cast<const ClipboardImageData *>(clipboard->mimeData());
+    if (!published)
+        QSKIP("The platform clipboard does not keep the QMimeData object");
+    QVERIFY(published->encodedFormats().isEmpty());
+    QVERIFY(published->hasImage());
+
+    QImage pasted;
+    QVERIFY(pasted.loadFromData(published->data("image/png"), "png"));
+    QCOMPARE(pasted.convertToFormat(QImage::Format_RGB32), source);
+    QCOMPARE(published->encodedFormats(), QStringList() << "image/png");
+    clipboard->clear();
+}
+
+void ImageBench::historyAppend_data()
+{
+    addResolutionRows();
+}
+
+// ScreenshotTool::archiveCapture: the GUI thread only scales the thumbnail
+// into the atlas; the .qoi file is written on the store's worker
+void ImageBench::historyAppend()
+{
+    QFETCH(QString, resolution);
+
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    HistoryStore store(dir.path());
+    QVERIFY2(store.isOpen(), qPrintable(store.errorString()));
+
+    const QImage image = images.value(resolution).convertToFormat(QImage::Format_RGB32);
+    const QImage preview = ImagePyramid(ImageBuffer(image)).scaled(
+        QSize(HistoryStore::ThumbnailWidth, HistoryStore::ThumbnailHeight));
+    quint64 id = 0;
+    QBENCHMARK {
+        id = store.append(image, PerceptualHash::compute(image), preview);
+    }
+    store.waitForWrites();
+
+    QVERIFY(id != 0);
+    QCOMPARE(store.load(id), image);
+}
+
+// Opening an archive of 2000 captures and drawing every thumbnail: reads
+// the index and the mapped atlas, decodes no image
+void ImageBench::historyOpen()
+{
+    const int captures = 2000;
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    {
+        HistoryStore store(dir.path());
+        QImage capture(320, 200, QImage::Format_RGB32);
+        for (int i = 0; i < captures; ++i) {
+            capture.fill(qRgb(i % 256, (i / 256) * 16, 128));
+            store.append(capture, PerceptualHash::compute(capture));
+        }
+    }
+
+    QBENCHMARK {
+        HistoryStore store(dir.path());
+        quint64 checksum = 0;
+        for (int i = 0; i < store.count(); ++i)
+            checksum += store.thumbnail(i).pixel(0, 0);
+        Q_UNUSED(checksum)
+    }
+
+    HistoryStore store(dir.path());
+    QCOMPARE(store.count(), captures);
+    const int last = captures - 1;
+    QCOMPARE(store.thumbnail(last).pixel(0, 0), qRgb(last % 256, (last / 256) * 16, 128));
+
+    // Retention drops the oldest captures and their files
+    store.setLimits(captures / 2, HistoryStore::DefaultMaxBytes);
+    QCOMPARE(store.count(), captures / 2);
+    QCOMPARE(store.load(store.entry(0).id).size(), QSize(320, 200));
+    QVERIFY(!QFile::exists(dir.filePath("1.qoi")));
+}
+
+void ImageBench::perceptualHash_data()
+{
+    addResolutionRows();
+}
+
+// ScreenshotTool::archiveCapture, per capture; a few milliseconds at 4K
+// at most. A changed clock must stay a near-duplicate, another screen not.
+void ImageBench::perceptualHash()
+{
+    QFETCH(QString, resolution);
+
+    const QImage image = images.value(resolution).convertToFormat(QImage::Format_RGB32);
+    quint64 hash = 0;
+    QBENCHMARK {
+        hash = PerceptualHash::compute(image);
+    }
+
+    QImage clock = image;
+    QPainter painter(&clock);
+    painter.fillRect(QRect(clock.width() - 120, clock.height() - 30, 100, 20), Qt::black);
+    painter.end();
+    QVERIFY(PerceptualHash::distance(hash, PerceptualHash::compute(clock))
+            <= PerceptualHash::NearDuplicateDistance);
+
+    const QImage other = image.mirrored(true, false);
+    QVERIFY(PerceptualHash::distance(hash, PerceptualHash::compute(other))
+            > PerceptualHash::NearDuplicateDistance);
+
+    DuplicateIndex index;
+    index.insert(1, PerceptualHash::compute(other), other.size());
+    index.insert(2, hash, image.size());
+    QCOMPARE(index.nearest(PerceptualHash::compute(clock), clock.size()).id, quint64(2));
+}
+
+void ImageBench::undoRedo_data()
+{
+    QTest::addColumn<QString>("resolution");
+    QTest::addColumn<int>("areaPercent");
+
+    for (const Synthetic::Resolution &resolution : Synthetic::Resolutions) {
+        QTest::addRow("%s 10%% area", resolution.name) << QString(resolution.name) << 10;
+        QTest::addRow("%s full frame", resolution.name) << QString(resolution.name) << 100;
+    }
+}
+
+// One undo plus one redo of a blur-sized edit; both must fit in a frame
+void ImageBench::undoRedo()
+{
+    QFETCH(QString, resolution);
+    QFETCH(int, areaPercent);
+
+    ImageBuffer image(images.value(resolution));
+    const QRect area(0, 0, image.width() * areaPercent / 100, image.height());
+
+    AnnotationLayer annotations;
+    UndoHistory history;
+    history.recordEdit(image.edit(), area);
+    image.edit().fill(Qt::black);
+
+    QBENCHMARK {
+        QVERIFY(history.undo(image, annotations));
+        QVERIFY(history.redo(image, annotations));
+    }
+}
+
+// Consecutive captures of one desktop: a clock and a cursor change every
+// frame, a window every fifth frame
+QVector<QImage> ImageBench::desktopSequence(const QString &resolution) const
+{
+    const QImage base = images.value(resolution).convertToFormat(QImage::Format_RGB32);
+    QVector<QImage> sequence;
+    for (int i = 0; i < 30; ++i) {
+        QImage frame = base.copy();
+        QPainter painter(&frame);
+        painter.fillRect(QRect(frame.width() - 120, frame.height() - 40, 100, 30), Qt::black);
+        painter.setPen(Qt::white);
+        painter.drawText(frame.width() - 110, frame.height() - 20, QString("12:%1").arg(i, 2, 10, QChar('0')));
+        painter.fillRect(QRect(200 + i * 20, 300 + i * 10, 16, 24), Qt::red);
+        if (i % 5 == 4)
+            painter.fillRect(QRect(400, 400, 600, 400), QColor(i * 8, 80, 160));
+        painter.end();
+        sequence.append(frame);
+    }
+    return sequence;
+}
+
+void ImageBench::captureStoreAppend_data()
+{
+    addResolutionRows();
+}
+
+// Hashing and delta extraction for a 30-frame sequence; the store must be
+// several times smaller than the raw frames and rebuild them exactly
+void ImageBench::captureStoreAppend()
+{
+    QFETCH(QString, resolution);
+
+    const QVector<QImage> sequence = desktopSequence(resolution);
+    CaptureStore store;
+    QBENCHMARK {
+        store.clear();
+        for (const QImage &frame : sequence)
+            store.append(frame);
+    }
+
+    for (int i = 0; i < sequence.size(); ++i)
+        QCOMPARE(store.frame(i), sequence.at(i));
+    const CaptureStore::Stats stats = store.stats();
+    qDebug("%s: %d frames, %d keyframes, %.1f MB raw, %.1f MB stored, ratio %.1f",
+           qPrintable(resolution), stats.frames, stats.keyframes,
+           stats.rawBytes / 1048576.0, stats.storedBytes / 1048576.0, stats.compressionRatio);
+    QVERIFY(stats.compressionRatio >= 4.0);
+}
+
+void ImageBench::captureStoreRebuild_data()
+{
+    addResolutionRows();
+}
+
+// Full frame from its keyframe plus changed tiles, e.g. when browsing
+void ImageBench::captureStoreRebuild()
+{
+    QFETCH(QString, resolution);
+
+    const QVector<QImage> sequence = desktopSequence(resolution);
+    CaptureStore store;
+    for (const QImage &frame : sequence)
+        store.append(frame);
+
+    QBENCHMARK {
+        QImage frame = store.frame(store.count() - 1);
+        Q_UNUSED(frame)
+    }
+}
+
+void ImageBench::multiScreenCapture_data()
+{
+    QTest::addColumn<QVector<CaptureSource::Screen>>("screens");
+
+    const CaptureSource::Screen left = { "left", QRect(0, 0, 3840, 2160), 1.0 };
+    const CaptureSource::Screen middle = { "middle", QRect(3840, 0, 3840, 2160), 1.0 };
+    const CaptureSource::Screen right = { "right", QRect(7680, 0, 3840, 2160), 1.0 };
+    QTest::newRow("1x 4K") << QVector<CaptureSource::Screen>{ left };
+    QTest::newRow("3x 4K") << QVector<CaptureSource::Screen>{ left, middle, right };
+
+    // 1920x1080 logical at 200% next to a 1080p panel placed lower
+    const CaptureSource::Screen hidpi = { "hidpi", QRect(0, 0, 1920, 1080), 2.0 };
+    const CaptureSource::Screen lodpi = { "lodpi", QRect(1920, 200, 1920, 1080), 1.0 };
+    QTest::newRow("mixed dpr") << QVector<CaptureSource::Screen>{ hidpi, lodpi };
+}
+
+// ScreenCapture::grab over a fake multi-screen source: per-screen grabs
+// composited concurrently into one virtual-desktop image
+void ImageBench::multiScreenCapture()
+{
+    QFETCH(QVector<CaptureSource::Screen>, screens);
+
+    SyntheticCaptureSource source(screens);
+    ScreenCapture::setSource(&source);
+
+    const ImageBuffer desktop = ScreenCapture::grab();
+    const qreal scale = ScreenCapture::captureScale();
+    const QRect geometry = ScreenCapture::virtualGeometry();
+    QCOMPARE(desktop.size(), geometry.size() * scale);
+
+    // Screens at the capture scale land pixel-exact at their place
+    const QImage pixels = desktop.image();
+    for (int i = 0; i < screens.size(); ++i) {
+        if (screens.at(i).devicePixelRatio != scale)
+            continue;
+        const QPoint origin = (screens.at(i).geometry.topLeft() - geometry.topLeft()) * scale;
+        QCOMPARE(pixels.pixel(origin + QPoint(17, 33)), SyntheticCaptureSource::expectedPixel(i, 17, 33));
+    }
+
+    QBENCHMARK {
+        ImageBuffer capture = ScreenCapture::grab();
+        Q_UNUSED(capture)
+    }
+    ScreenCapture::setSource(nullptr);
+}
+
+void ImageBench::burstFrame_data()
+{
+    multiScreenCapture_data();
+}
+
+// One burst frame: ScreenCapture::grabInto a preallocated ring buffer. The
+// buffer must be written in place, never reallocated.
+void ImageBench::burstFrame()
+{
+    QFETCH(QVector<CaptureSource::Screen>, screens);
+
+    SyntheticCaptureSource source(screens);
+    ScreenCapture::setSource(&source);
+
+    const QRect geometry = ScreenCapture::virtualGeometry();
+    const qreal scale = ScreenCapture::captureScale();
+    QImage frame(geometry.size() * scale, QImage::Format_RGB32);
+    const uchar *bits = frame.constBits();
+
+    QVERIFY(ScreenCapture::grabInto(frame));
+    QCOMPARE(frame.constBits(), bits);
+    QCOMPARE(frame, ScreenCapture::grab().image());
+
+    QBENCHMARK {
+        ScreenCapture::grabInto(frame);
+    }
+    QCOMPARE(frame.constBits(), bits);
+    ScreenCapture::setSource(nullptr);
+}
+
+BENCHMARK_MAIN(ImageBench)
+
+#include "tst_imagebench.moc"
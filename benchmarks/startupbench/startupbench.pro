@@ -0,0 +1,10 @@
+include(../benchmarks.pri)
+
+TARGET = startupbench
+TEMPLATE = app
+
+# Build ScreenshotTool.pro first; SCREENSHOTTOOL_BINARY overrides the path
+DEFINES += APP_BINARY_DIR=\\\"$$APP_ROOT/release\\\"
+
+SOURCES += \
+    tst_startupbench.cpp
@@ -0,0 +1,81 @@
+#include "benchmarkmain.h"
+#include <QProcess>
+#include <QTemporaryDir>
+
+// Cold start of the application binary, measured from process start:
+// to the first painted preview of the window, and to the file written by
+// the command-line mode. Each iteration launches a fresh process.
+class StartupBench : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+
+    void firstPreview();
+    void commandLineCapture();
+
+private:
+    int launch(const QStringList &arguments, const QProcessEnvironment &environment);
+
+    QString binary;
+};
+
+void StartupBench::initTestCase()
+{
+    binary = qEnvironmentVariable("SCREENSHOTTOOL_BINARY");
+    if (binary.isEmpty()) {
+#ifdef Q_OS_WIN
+        binary = QStringLiteral(APP_BINARY_DIR "/ScreenshotTool.exe");
+#else
+        binary = QStringLiteral(APP_BINARY_DIR "/ScreenshotTool");
+#endif
+    }
+    if (!QFileInfo(binary).isExecutable())
+        QSKIP("ScreenshotTool binary not found; build it or set SCREENSHOTTOOL_BINARY");
+}
+
+int StartupBench::launch(const QStringList &arguments, const QProcessEnvironment &environment)
+{
+    QProcess process;
+    process.setProcessEnvironment(environment);
+    process.start(binary, arguments);
+    if (!process.waitForFinished(30000)) {
+        process.kill();
+        return -1;
+    }
+    return process.exitStatus() == QProcess::NormalExit ? process.exitCode() : -1;
+}
+
+// Window mode: exits as soon as the first capture's preview is painted
+void StartupBench::firstPreview()
+{
+    // A fresh archive per run: the first capture is written to it
+    QTemporaryDir history;
+    QVERIFY(history.isValid());
+    QProcessEnvironment environment = QProcessEnvironment::systemEnvironment();
+    environment.insert("SCREENSHOTTOOL_STARTUP_PROBE", "1");
+    environment.insert("SCREENSHOTTOOL_HISTORY_DIR", history.path());
+
+    QBENCHMARK {
+        QCOMPARE(launch(QStringList(), environment), 0);
+    }
+}
+
+// Headless mode: full-screen capture written as PNG
+void StartupBench::commandLineCapture()
+{
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    const QString out = dir.filePath("capture.png");
+
+    QBENCHMARK {
+        QCOMPARE(launch({ "--capture", "full", "--out", out },
+                        QProcessEnvironment::systemEnvironment()), 0);
+    }
+    QVERIFY(QFileInfo(out).size() > 0);
+}
+
+BENCHMARK_MAIN(StartupBench)
+
+#include "tst_startupbench.moc"
@@ -0,0 +1,67 @@
+#ifndef SYNTHETICIMAGE_H
+#define SYNTHETICIMAGE_H
+
+#include <QImage>
+#include <QLinearGradient>
+#include <QPainter>
+#include <QRandomGenerator>
+#include <QSize>
+#include <QString>
+
+namespace Synthetic {
+
+struct Resolution {
+    const char *name;
+    int width;
+    int height;
+};
+
+const Resolution Resolutions[] = {
+    { "1080p", 1920, 1080 },
+    { "4K", 3840, 2160 },
+    { "8K", 7680, 4320 }
+};
+
+// Deterministic desktop-like capture: flat panels and title bars, a gradient,
+// lines of text and a noisy "photo" area, so that encoders and filters see
+// the mix of flat and busy content of a real screenshot.
+inline QImage screenshot(const QSize &size, quint32 seed = 1)
+{
+    QImage image(size, QImage::Format_ARGB32_Premultiplied);
+    image.fill(QColor(0xF8, 0xF9, 0xFA));
+
+    QRandomGenerator random(seed);
+    QPainter painter(&image);
+
+    QLinearGradient gradient(0, 0, size.width(), size.height());
+    gradient.setColorAt(0, QColor(0x0D, 0x6E, 0xFD));
+    gradient.setColorAt(1, QColor(0x00, 0x89, 0x7B));
+    painter.fillRect(QRect(0, 0, size.width(), size.height() / 3), gradient);
+
+    // Windows with title bars and text
+    const int windows = 6;
+    for (int i = 0; i < windows; ++i) {
+        const QRect frame(random.bounded(size.width() * 2 / 3),
+                          random.bounded(size.height() * 2 / 3),
+                          size.width() / 3, size.height() / 3);
+        painter.fillRect(frame, Qt::white);
+        painter.fillRect(QRect(frame.topLeft(), QSize(frame.width(), 32)), QColor(0x2D, 0x2D, 0x30));
+        painter.setPen(Qt::black);
+        painter.setFont(QFont("Arial", 11));
+        for (int y = frame.top() + 56; y < frame.bottom(); y += 20)
+            painter.drawText(frame.left() + 12, y, QString("Line %1 of window %2: lorem ipsum dolor sit amet").arg(y).arg(i));
+    }
+
+    // Photo-like noise in the bottom-right quarter
+    painter.end();
+    for (int y = size.height() * 3 / 4; y < size.height(); ++y) {
+        QRgb *line = reinterpret_cast<QRgb *>(image.scanLine(y));
+        for (int x = size.width() * 3 / 4; x < size.width(); ++x)
+            line[x] = 0xff000000u | (random.generate() & 0x00ffffffu);
+    }
+    return image;
+}
+
+} // namespace Synthetic
+
+#endif // SYNTHETICIMAGE_H
@@ -0,0 +1,236 @@
+#include "blurengine.h"
+#include "blurkernels.h"
+#include "imagepyramid.h"
+#include <QAtomicInt>
+#include <QThread>
+#include <QThreadPool>
+#include <QtConcurrent>
+#include <cmath>
+
+namespace {
+
+const int kMaxRadius = 32767;
+
+// Bands are kept at least this many halos tall (see splitIntoBands)
+const int kMinBandHalos = 4;
+const int kMinBandRows = 64;
+
+inline int windowCount(int pos, int radius, int length)
+{
+    return qMin(pos + radius, length - 1) - qMax(pos - radius, 0) + 1;
+}
+
+bool isBlurFormat(QImage::Format format)
+{
+    return format == QImage::Format_RGB32
+        || format == QImage::Format_ARGB32
+        || format == QImage::Format_ARGB32_Premultiplied;
+}
+
+void blurPasses(QImage &image, int radius, BlurEngine::Quality quality)
+{
+    QImage scratch(image.size(), image.format());
+    for (int passRadius : BlurEngine::passRadii(radius, quality))
+        BlurEngine::boxBlurPass(image, scratch, passRadius);
+}
+
+} // namespace
+
+namespace BlurEngine {
+
+QVector<int> passRadii(int radius, Quality quality)
+{
+    QVector<int> radii;
+    if (radius <= 0)
+        return radii;
+
+    radius = qMin(radius, kMaxRadius);
+
+    if (quality == Quality::Box) {
+        radii.append(radius);
+        return radii;
+    }
+
+    // Box widths whose three-fold convolution has the variance of a
+    // Gaussian with sigma = radius / 2 (widths wl and wl + 2 mixed).
+    const int passes = 3;
+    const double sigma = radius / 2.0;
+    const double idealWidth = std::sqrt(12.0 * sigma * sigma / passes + 1.0);
+    int lowerWidth = static_cast<int>(std::floor(idealWidth));
+    if (lowerWidth % 2 == 0)
+        --lowerWidth;
+    const int upperWidth = lowerWidth + 2;
+    const double idealLower = (12.0 * sigma * sigma
+                               - passes * lowerWidth * lowerWidth
+                               - 4.0 * passes * lowerWidth
+                               - 3.0 * passes) / (-4.0 * lowerWidth - 4.0);
+    const int lowerCount = static_cast<int>(std::lround(idealLower));
+
+    for (int i = 0; i < passes; ++i) {
+        const int width = i < lowerCount ? lowerWidth : upperWidth;
+        radii.append(qMax(1, (width - 1) / 2));
+    }
+    return radii;
+}
+
+int haloRows(int radius, Quality quality)
+{
+    int halo = 0;
+    for (int passRadius : passRadii(radius, quality))
+        halo += passRadius;
+    return halo;
+}
+
+QVector<Band> splitIntoBands(int height, int bandCount, int halo)
+{
+    QVector<Band> bands;
+    if (height <= 0)
+        return bands;
+
+    const int minRows = qMax(kMinBandRows, halo * kMinBandHalos);
+    bandCount = qBound(1, qMin(bandCount, height / minRows), height);
+
+    const int baseRows = height / bandCount;
+    const int extraRows = height % bandCount;
+    int top = 0;
+    for (int i = 0; i < bandCount; ++i) {
+        const Band band = { top, baseRows + (i < extraRows ? 1 : 0) };
+        bands.append(band);
+        top += band.rows;
+    }
+    return bands;
+}
+
+void blurBand(const QImage &source, uchar *targetBits, int targetBytesPerLine,
+              const Band &band, int radius, Quality quality)
+{
+    // Horizontal passes never cross rows, and each vertical pass moves an
+    // edge error by at most its radius, so a halo of the summed radii keeps
+    // the band rows identical to a whole-image blur.
+    const int halo = haloRows(radius, quality);
+    const int top = qMax(0, band.top - halo);
+    const int bottom = qMin(source.height(), band.top + band.rows + halo);
+
+    QImage slice = source.copy(0, top, source.width(), bottom - top);
+    blurPasses(slice, radius, quality);
+
+    const int rowBytes = source.width() * 4;
+    for (int y = band.top; y < band.top + band.rows; ++y) {
+        memcpy(targetBits + qptrdiff(y) * targetBytesPerLine,
+               slice.constScanLine(y - top), size_t(rowBytes));
+    }
+}
+
+void blurParallel(QImage &image, int radius, Quality quality, int threadCount,
+                  const std::function<void(int, int)> &progress)
+{
+    if (image.isNull() || radius <= 0)
+        return;
+
+    if (threadCount <= 0)
+        threadCount = QThread::idealThreadCount();
+
+    const QImage::Format originalFormat = image.format();
+    const QImage source = isBlurFormat(originalFormat)
+        ? image
+        : image.convertToFormat(QImage::Format_ARGB32_Premultiplied);
+
+    const QVector<Band> bands = splitIntoBands(source.height(), threadCount,
+                                               haloRows(radius, quality));
+    QImage target(source.size(), source.format());
+    uchar *targetBits = target.bits();
+    const int targetBytesPerLine = target.bytesPerLine();
+
+    // A private pool, so the caller may itself run on the global pool and
+    // the thread count can be chosen per call (used for scaling reports).
+    QThreadPool pool;
+    pool.setMaxThreadCount(threadCount);
+
+    QAtomicInt finished(0);
+    const int total = bands.size();
+    QList<QFuture<void> > futures;
+    for (const Band &band : bands) {
+        futures.append(QtConcurrent::run(&pool, [&, band]() {
+            blurBand(source, targetBits, targetBytesPerLine, band, radius, quality);
+            const int done = finished.fetchAndAddOrdered(1) + 1;
+            if (progress)
+                progress(done, total);
+        }));
+    }
+    for (QFuture<void> &future : futures)
+        future.waitForFinished();
+
+    image = target.format() == originalFormat ? target : target.convertToFormat(originalFormat);
+}
+
+void boxBlurPass(QImage &image, QImage &scratch, int radius)
+{
+    const int width = image.width();
+    const int height = image.height();
+    if (width == 0 || height == 0 || radius <= 0)
+        return;
+
+    const BlurKernels::Kernels &k = BlurKernels::activeKernels();
+
+    // Horizontal pass: image -> scratch
+    for (int y = 0; y < height; ++y) {
+        k.horizontalRow(reinterpret_cast<const quint32 *>(image.constScanLine(y)),
+                        reinterpret_cast<quint32 *>(scratch.scanLine(y)),
+                        width, radius);
+    }
+
+    // Vertical pass: scratch -> image, one row of column sums at a time
+    QVector<quint32> sums(width * 4, 0);
+    const int preload = qMin(radius, height);
+    for (int y = 0; y < preload; ++y)
+        k.addRow(sums.data(), reinterpret_cast<const quint32 *>(scratch.constScanLine(y)), width);
+
+    for (int y = 0; y < height; ++y) {
+        const int add = y + radius;
+        if (add < height)
+            k.addRow(sums.data(), reinterpret_cast<const quint32 *>(scratch.constScanLine(add)), width);
+        const int remove = y - radius - 1;
+        if (remove >= 0)
+            k.subtractRow(sums.data(), reinterpret_cast<const quint32 *>(scratch.constScanLine(remove)), width);
+        k.averageRow(sums.constData(),
+                     reinterpret_cast<quint32 *>(image.scanLine(y)),
+                     width, BlurKernels::reciprocal(windowCount(y, radius, height)));
+    }
+}
+
+void blur(QImage &image, int radius, Quality quality)
+{
+    if (image.isNull() || radius <= 0)
+        return;
+
+    const QImage::Format originalFormat = image.format();
+    if (!isBlurFormat(originalFormat))
+        image = image.convertToFormat(QImage::Format_ARGB32_Premultiplied);
+
+    blurPasses(image, radius, quality);
+
+    if (image.format() != originalFormat)
+        image = image.convertToFormat(originalFormat);
+}
+
+QImage blurPreview(const QImage &image, int radius, Quality quality, int *scale)
+{
+    int factor = 1;
+    QImage preview = image;
+    if (preview.format() != QImage::Format_RGB32
+            && preview.format() != QImage::Format_ARGB32_Premultiplied)
+        preview = preview.convertToFormat(QImage::Format_ARGB32_Premultiplied);
+
+    while (factor < MaxPreviewScale && radius / (factor * 2) >= 1
+           && preview.width() >= 2 && preview.height() >= 2) {
+        preview = ImagePyramid::halve(preview);
+        factor *= 2;
+    }
+
+    blur(preview, qMax(1, (radius + factor / 2) / factor), quality);
+    if (scale)
+        *scale = factor;
+    return preview;
+}
+
+} // namespace BlurEngine
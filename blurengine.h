@@ -0,0 +1,66 @@
+#ifndef BLURENGINE_H
+#define BLURENGINE_H
+
+#include <QImage>
+#include <QVector>
+#include <functional>
+
+// Separable sliding-window blur.
+// Each box pass is a horizontal running sum over scanLine() memory followed
+// by a vertical running sum, so the cost per pixel does not depend on the
+// radius. Edge pixels are averaged over the in-bounds part of the window only,
+// exactly like the original per-pixel box blur did.
+namespace BlurEngine {
+
+enum class Quality {
+    Box,        // one box pass of the given radius
+    Gaussian    // three box passes approximating a Gaussian (sigma = radius / 2)
+};
+
+// Blurs the whole image in place. Images that are not 32-bit are converted
+// to ARGB32_Premultiplied and converted back to their original format.
+void blur(QImage &image, int radius, Quality quality = Quality::Gaussian);
+
+// Blurred copy of the whole image at reduced resolution for interactive
+// previews: the image is halved (up to MaxPreviewScale times smaller while
+// the scaled radius stays >= 1) and blurred with radius / scale. '*scale'
+// receives the reduction factor. The result is 32-bit.
+const int MaxPreviewScale = 4;
+QImage blurPreview(const QImage &image, int radius, Quality quality, int *scale);
+
+// Box radii used for each pass of the given quality mode.
+QVector<int> passRadii(int radius, Quality quality);
+
+// Rows of context a band needs above and below itself so that blurring it
+// in isolation gives exactly the same rows as blurring the whole image.
+int haloRows(int radius, Quality quality);
+
+// A horizontal band of output rows for tiled execution.
+struct Band {
+    int top;
+    int rows;
+};
+
+// Splits 'height' rows into at most 'bandCount' bands, keeping every band at
+// least a few halos tall so the overlap stays a small fraction of the work.
+QVector<Band> splitIntoBands(int height, int bandCount, int halo);
+
+// Blurs 'band' of 32-bit 'source' (with halo rows around it) and writes the
+// result rows into 'targetBits', a buffer laid out like 'source'. Bands
+// write disjoint rows, so they can run concurrently on a shared target.
+void blurBand(const QImage &source, uchar *targetBits, int targetBytesPerLine,
+              const Band &band, int radius, Quality quality);
+
+// Same result as blur(), computed in row bands spread over 'threadCount'
+// threads (0 = QThread::idealThreadCount()). 'progress' is called from the
+// worker threads with (finished bands, total bands).
+void blurParallel(QImage &image, int radius, Quality quality, int threadCount = 0,
+                  const std::function<void(int, int)> &progress = std::function<void(int, int)>());
+
+// Single box pass over 32-bit pixels. 'scratch' must have the same size and
+// format as 'image'; it is used as the intermediate for the horizontal pass.
+void boxBlurPass(QImage &image, QImage &scratch, int radius);
+
+} // namespace BlurEngine
+
+#endif // BLURENGINE_H
@@ -0,0 +1,378 @@
+#include "blurkernels.h"
+#include <QAtomicInt>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#  define BLUR_HAVE_SSE2
+#  include <emmintrin.h>
+#endif
+
+// AVX2 code is compiled through a target attribute, so the rest of the
+// application keeps running on CPUs without it. GCC does not realign the
+// Win64 stack to 32 bytes (GCC bug 54412), and unoptimized MinGW-w64 builds
+// spill __m256i values with aligned moves; those builds stay on SSE2.
+#if defined(BLUR_HAVE_SSE2) && (defined(__GNUC__) || defined(__clang__)) \
+    && !(defined(_WIN64) && !defined(__clang__) && !defined(__OPTIMIZE__))
+#  define BLUR_HAVE_AVX2
+#  define BLUR_TARGET_AVX2 __attribute__((target("avx2")))
+#  include <immintrin.h>
+#endif
+
+namespace {
+
+using BlurKernels::InstructionSet;
+using BlurKernels::Kernels;
+
+inline quint32 average(quint32 sum, quint32 recip)
+{
+    return (sum * recip + (1u << (BlurKernels::ReciprocalShift - 1))) >> BlurKernels::ReciprocalShift;
+}
+
+inline int windowCount(int pos, int radius, int length)
+{
+    return qMin(pos + radius, length - 1) - qMax(pos - radius, 0) + 1;
+}
+
+// Reciprocal of the window size at 'pos'; only edge windows are clipped.
+inline quint32 windowReciprocal(int pos, int radius, int length, quint32 interior)
+{
+    if (pos >= radius && pos + radius < length)
+        return interior;
+    return BlurKernels::reciprocal(windowCount(pos, radius, length));
+}
+
+// ---------------------------------------------------------------------------
+// Scalar
+
+void horizontalRowScalar(const quint32 *src, quint32 *dst, int width, int radius)
+{
+    const quint32 interior = BlurKernels::reciprocal(2 * radius + 1);
+    quint32 s0 = 0, s1 = 0, s2 = 0, s3 = 0;
+    const int preload = qMin(radius, width);
+    for (int x = 0; x < preload; ++x) {
+        const quint32 p = src[x];
+        s0 += p & 0xff;
+        s1 += (p >> 8) & 0xff;
+        s2 += (p >> 16) & 0xff;
+        s3 += p >> 24;
+    }
+
+    for (int x = 0; x < width; ++x) {
+        const int add = x + radius;
+        if (add < width) {
+            const quint32 p = src[add];
+            s0 += p & 0xff;
+            s1 += (p >> 8) & 0xff;
+            s2 += (p >> 16) & 0xff;
+            s3 += p >> 24;
+        }
+        const int remove = x - radius - 1;
+        if (remove >= 0) {
+            const quint32 p = src[remove];
+            s0 -= p & 0xff;
+            s1 -= (p >> 8) & 0xff;
+            s2 -= (p >> 16) & 0xff;
+            s3 -= p >> 24;
+        }
+
+        const quint32 recip = windowReciprocal(x, radius, width, interior);
+        dst[x] = average(s0, recip)
+               | (average(s1, recip) << 8)
+               | (average(s2, recip) << 16)
+               | (average(s3, recip) << 24);
+    }
+}
+
+void addRowScalar(quint32 *sums, const quint32 *row, int width)
+{
+    for (int x = 0; x < width; ++x) {
+        const quint32 p = row[x];
+        quint32 *s = sums + x * 4;
+        s[0] += p & 0xff;
+        s[1] += (p >> 8) & 0xff;
+        s[2] += (p >> 16) & 0xff;
+        s[3] += p >> 24;
+    }
+}
+
+void subtractRowScalar(quint32 *sums, const quint32 *row, int width)
+{
+    for (int x = 0; x < width; ++x) {
+        const quint32 p = row[x];
+        quint32 *s = sums + x * 4;
+        s[0] -= p & 0xff;
+        s[1] -= (p >> 8) & 0xff;
+        s[2] -= (p >> 16) & 0xff;
+        s[3] -= p >> 24;
+    }
+}
+
+void averageRowScalar(const quint32 *sums, quint32 *dst, int width, quint32 recip)
+{
+    for (int x = 0; x < width; ++x) {
+        const quint32 *s = sums + x * 4;
+        dst[x] = average(s[0], recip)
+               | (average(s[1], recip) << 8)
+               | (average(s[2], recip) << 16)
+               | (average(s[3], recip) << 24);
+    }
+}
+
+#ifdef BLUR_HAVE_SSE2
+// ---------------------------------------------------------------------------
+// SSE2: one pixel = one register of four 32-bit channel lanes
+
+inline __m128i unpackPixel(quint32 p)
+{
+    const __m128i zero = _mm_setzero_si128();
+    return _mm_unpacklo_epi16(_mm_unpacklo_epi8(_mm_cvtsi32_si128(int(p)), zero), zero);
+}
+
+// (sum * recip + half) >> shift on four lanes; products fit in 32 bits,
+// so the 64-bit multiplies give exactly the scalar result.
+inline __m128i averageLanes(__m128i sums, __m128i recip, __m128i half)
+{
+    const __m128i even = _mm_srli_epi64(_mm_add_epi64(_mm_mul_epu32(sums, recip), half),
+                                        BlurKernels::ReciprocalShift);
+    const __m128i odd = _mm_srli_epi64(_mm_add_epi64(_mm_mul_epu32(_mm_srli_epi64(sums, 32), recip), half),
+                                       BlurKernels::ReciprocalShift);
+    return _mm_or_si128(even, _mm_slli_epi64(odd, 32));
+}
+
+inline quint32 packPixel(__m128i lanes)
+{
+    const __m128i words = _mm_packs_epi32(lanes, lanes);
+    return quint32(_mm_cvtsi128_si32(_mm_packus_epi16(words, words)));
+}
+
+void horizontalRowSSE2(const quint32 *src, quint32 *dst, int width, int radius)
+{
+    const __m128i half = _mm_set1_epi64x(1 << (BlurKernels::ReciprocalShift - 1));
+    const quint32 interior = BlurKernels::reciprocal(2 * radius + 1);
+    __m128i sum = _mm_setzero_si128();
+    const int preload = qMin(radius, width);
+    for (int x = 0; x < preload; ++x)
+        sum = _mm_add_epi32(sum, unpackPixel(src[x]));
+
+    for (int x = 0; x < width; ++x) {
+        const int add = x + radius;
+        if (add < width)
+            sum = _mm_add_epi32(sum, unpackPixel(src[add]));
+        const int remove = x - radius - 1;
+        if (remove >= 0)
+            sum = _mm_sub_epi32(sum, unpackPixel(src[remove]));
+
+        const __m128i recip = _mm_set1_epi32(int(windowReciprocal(x, radius, width, interior)));
+        dst[x] = packPixel(averageLanes(sum, recip, half));
+    }
+}
+
+template <bool Add>
+inline void accumulateRowSSE2(quint32 *sums, const quint32 *row, int width)
+{
+    const __m128i zero = _mm_setzero_si128();
+    int x = 0;
+    for (; x + 4 <= width; x += 4) {
+        const __m128i pixels = _mm_loadu_si128(reinterpret_cast<const __m128i *>(row + x));
+        const __m128i lo = _mm_unpacklo_epi8(pixels, zero);
+        const __m128i hi = _mm_unpackhi_epi8(pixels, zero);
+        const __m128i channels[4] = {
+            _mm_unpacklo_epi16(lo, zero), _mm_unpackhi_epi16(lo, zero),
+            _mm_unpacklo_epi16(hi, zero), _mm_unpackhi_epi16(hi, zero)
+        };
+        __m128i *s = reinterpret_cast<__m128i *>(sums + x * 4);
+        for (int i = 0; i < 4; ++i) {
+            const __m128i current = _mm_loadu_si128(s + i);
+            _mm_storeu_si128(s + i, Add ? _mm_add_epi32(current, channels[i])
+                                        : _mm_sub_epi32(current, channels[i]));
+        }
+    }
+    if (Add)
+        addRowScalar(sums + x * 4, row + x, width - x);
+    else
+        subtractRowScalar(sums + x * 4, row + x, width - x);
+}
+
+void addRowSSE2(quint32 *sums, const quint32 *row, int width)
+{
+    accumulateRowSSE2<true>(sums, row, width);
+}
+
+void subtractRowSSE2(quint32 *sums, const quint32 *row, int width)
+{
+    accumulateRowSSE2<false>(sums, row, width);
+}
+
+void averageRowSSE2(const quint32 *sums, quint32 *dst, int width, quint32 recip)
+{
+    const __m128i half = _mm_set1_epi64x(1 << (BlurKernels::ReciprocalShift - 1));
+    const __m128i r = _mm_set1_epi32(int(recip));
+    int x = 0;
+    for (; x + 4 <= width; x += 4) {
+        const __m128i *s = reinterpret_cast<const __m128i *>(sums + x * 4);
+        const __m128i p0 = averageLanes(_mm_loadu_si128(s + 0), r, half);
+        const __m128i p1 = averageLanes(_mm_loadu_si128(s + 1), r, half);
+        const __m128i p2 = averageLanes(_mm_loadu_si128(s + 2), r, half);
+        const __m128i p3 = averageLanes(_mm_loadu_si128(s + 3), r, half);
+        const __m128i packed = _mm_packus_epi16(_mm_packs_epi32(p0, p1), _mm_packs_epi32(p2, p3));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + x), packed);
+    }
+    averageRowScalar(sums + x * 4, dst + x, width - x, recip);
+}
+#endif // BLUR_HAVE_SSE2
+
+#ifdef BLUR_HAVE_AVX2
+// ---------------------------------------------------------------------------
+// AVX2: two pixels per register, eight pixels per iteration
+
+BLUR_TARGET_AVX2
+inline __m256i averageLanesAVX2(__m256i sums, __m256i recip, __m256i half)
+{
+    const __m256i even = _mm256_srli_epi64(_mm256_add_epi64(_mm256_mul_epu32(sums, recip), half),
+                                           BlurKernels::ReciprocalShift);
+    const __m256i odd = _mm256_srli_epi64(_mm256_add_epi64(_mm256_mul_epu32(_mm256_srli_epi64(sums, 32), recip), half),
+                                          BlurKernels::ReciprocalShift);
+    return _mm256_or_si256(even, _mm256_slli_epi64(odd, 32));
+}
+
+// Two pixels' channel sums += / -= two unpacked pixels
+template <bool Add>
+BLUR_TARGET_AVX2
+inline void accumulateAVX2(__m256i *sums, __m256i channels)
+{
+    const __m256i current = _mm256_loadu_si256(sums);
+    _mm256_storeu_si256(sums, Add ? _mm256_add_epi32(current, channels)
+                                  : _mm256_sub_epi32(current, channels));
+}
+
+template <bool Add>
+BLUR_TARGET_AVX2
+inline void accumulateRowAVX2(quint32 *sums, const quint32 *row, int width)
+{
+    int x = 0;
+    for (; x + 8 <= width; x += 8) {
+        const __m128i *pixels = reinterpret_cast<const __m128i *>(row + x);
+        const __m128i lo = _mm_loadu_si128(pixels);
+        const __m128i hi = _mm_loadu_si128(pixels + 1);
+        __m256i *s = reinterpret_cast<__m256i *>(sums + x * 4);
+        // No local array of __m256i: it would live on the stack (see above)
+        accumulateAVX2<Add>(s + 0, _mm256_cvtepu8_epi32(lo));
+        accumulateAVX2<Add>(s + 1, _mm256_cvtepu8_epi32(_mm_srli_si128(lo, 8)));
+        accumulateAVX2<Add>(s + 2, _mm256_cvtepu8_epi32(hi));
+        accumulateAVX2<Add>(s + 3, _mm256_cvtepu8_epi32(_mm_srli_si128(hi, 8)));
+    }
+    if (Add)
+        addRowSSE2(sums + x * 4, row + x, width - x);
+    else
+        subtractRowSSE2(sums + x * 4, row + x, width - x);
+}
+
+BLUR_TARGET_AVX2
+void addRowAVX2(quint32 *sums, const quint32 *row, int width)
+{
+    accumulateRowAVX2<true>(sums, row, width);
+}
+
+BLUR_TARGET_AVX2
+void subtractRowAVX2(quint32 *sums, const quint32 *row, int width)
+{
+    accumulateRowAVX2<false>(sums, row, width);
+}
+
+BLUR_TARGET_AVX2
+void averageRowAVX2(const quint32 *sums, quint32 *dst, int width, quint32 recip)
+{
+    const __m256i half = _mm256_set1_epi64x(1 << (BlurKernels::ReciprocalShift - 1));
+    const __m256i r = _mm256_set1_epi32(int(recip));
+    // packs/packus work per 128-bit lane and leave pixels as 0,2,4,6,1,3,5,7
+    const __m256i order = _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7);
+    int x = 0;
+    for (; x + 8 <= width; x += 8) {
+        const __m256i *s = reinterpret_cast<const __m256i *>(sums + x * 4);
+        const __m256i p01 = averageLanesAVX2(_mm256_loadu_si256(s + 0), r, half);
+        const __m256i p23 = averageLanesAVX2(_mm256_loadu_si256(s + 1), r, half);
+        const __m256i p45 = averageLanesAVX2(_mm256_loadu_si256(s + 2), r, half);
+        const __m256i p67 = averageLanesAVX2(_mm256_loadu_si256(s + 3), r, half);
+        const __m256i packed = _mm256_packus_epi16(_mm256_packs_epi32(p01, p23),
+                                                   _mm256_packs_epi32(p45, p67));
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(dst + x),
+                            _mm256_permutevar8x32_epi32(packed, order));
+    }
+    averageRowSSE2(sums + x * 4, dst + x, width - x, recip);
+}
+#endif // BLUR_HAVE_AVX2
+
+const Kernels scalarKernels = {
+    horizontalRowScalar, addRowScalar, subtractRowScalar, averageRowScalar
+};
+
+#ifdef BLUR_HAVE_SSE2
+const Kernels sse2Kernels = {
+    horizontalRowSSE2, addRowSSE2, subtractRowSSE2, averageRowSSE2
+};
+#endif
+
+#ifdef BLUR_HAVE_AVX2
+// The horizontal pass is a serial dependency chain per row, so AVX2 reuses
+// the SSE2 version (one pixel of four channels is exactly one xmm register).
+const Kernels avx2Kernels = {
+    horizontalRowSSE2, addRowAVX2, subtractRowAVX2, averageRowAVX2
+};
+#endif
+
+QAtomicInt activeSet(-1);
+
+} // namespace
+
+namespace BlurKernels {
+
+InstructionSet detectedInstructionSet()
+{
+#ifdef BLUR_HAVE_AVX2
+    static const bool hasAvx2 = __builtin_cpu_supports("avx2");
+    if (hasAvx2)
+        return InstructionSet::AVX2;
+#endif
+#ifdef BLUR_HAVE_SSE2
+    return InstructionSet::SSE2;
+#else
+    return InstructionSet::Scalar;
+#endif
+}
+
+const Kernels &kernels(InstructionSet set)
+{
+    const InstructionSet best = detectedInstructionSet();
+    if (int(set) > int(best))
+        set = best;
+
+    switch (set) {
+#ifdef BLUR_HAVE_AVX2
+    case InstructionSet::AVX2:
+        return avx2Kernels;
+#endif
+#ifdef BLUR_HAVE_SSE2
+    case InstructionSet::SSE2:
+        return sse2Kernels;
+#endif
+    default:
+        return scalarKernels;
+    }
+}
+
+const Kernels &activeKernels()
+{
+    return kernels(activeInstructionSet());
+}
+
+InstructionSet activeInstructionSet()
+{
+    const int set = activeSet.loadAcquire();
+    return set < 0 ? detectedInstructionSet() : InstructionSet(set);
+}
+
+void setActiveInstructionSet(InstructionSet set)
+{
+    activeSet.storeRelease(int(set));
+}
+
+} // namespace BlurKernels
@@ -0,0 +1,51 @@
+#ifndef BLURKERNELS_H
+#define BLURKERNELS_H
+
+#include <QtGlobal>
+
+// Pixel kernels behind BlurEngine. Every kernel works on 32-bit
+// ARGB32(_Premultiplied) pixels and handles all four channels in one pass;
+// channel sums are laid out in memory byte order (4 x quint32 per pixel).
+//
+// All implementations are integer-only and must produce bit-identical
+// output: averages are (sum * reciprocal + 2^23) >> 24 everywhere.
+namespace BlurKernels {
+
+const int ReciprocalShift = 24;
+
+enum class InstructionSet {
+    Scalar,
+    SSE2,
+    AVX2
+};
+
+struct Kernels {
+    // Running-sum box filter over one row: src -> dst.
+    void (*horizontalRow)(const quint32 *src, quint32 *dst, int width, int radius);
+    // Adds / subtracts one row of pixels to / from the column sums.
+    void (*addRow)(quint32 *sums, const quint32 *row, int width);
+    void (*subtractRow)(quint32 *sums, const quint32 *row, int width);
+    // Writes averaged column sums as one row of pixels.
+    void (*averageRow)(const quint32 *sums, quint32 *dst, int width, quint32 recip);
+};
+
+inline quint32 reciprocal(int count)
+{
+    return ((1u << ReciprocalShift) + quint32(count) / 2) / quint32(count);
+}
+
+// Best instruction set supported by both the build and the running CPU.
+InstructionSet detectedInstructionSet();
+
+// Kernels for the given instruction set; falls back to the best supported
+// one when the requested set is unavailable.
+const Kernels &kernels(InstructionSet set);
+
+// Kernels used by BlurEngine (detectedInstructionSet() unless overridden).
+const Kernels &activeKernels();
+InstructionSet activeInstructionSet();
+void setActiveInstructionSet(InstructionSet set);
+
+} // namespace BlurKernels
+
+#endif // BLURKERNELS_H
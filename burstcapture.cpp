@@ -0,0 +1,155 @@
+#include "burstcapture.h"
+#include "profiler.h"
+#include "screencapture.h"
+#include <QtDebug>
+
+BurstCapture::BurstCapture(QObject *parent)
+    : QObject(parent),
+      maxBytes(DefaultMaxBytes),
+      rate(1),
+      limit(0),
+      next(0),
+      count(0),
+      captured(0),
+      dropped(0),
+      lastTick(0),
+      stoppedMs(0)
+{
+    qRegisterMetaType<BurstCapture::Stats>();
+    timer.setTimerType(Qt::PreciseTimer);
+    connect(&timer, &QTimer::timeout, this, &BurstCapture::captureFrame);
+}
+
+bool BurstCapture::start(int capacity, int framesPerSecond, int frameLimit)
+{
+    stop();
+    rate = qBound(1, framesPerSecond, 1000);
+    limit = qMax(0, frameLimit);
+
+    const QRect desktop = ScreenCapture::virtualGeometry();
+    const qreal scale = ScreenCapture::captureScale();
+    const QSize frameSize(qRound(desktop.width() * scale), qRound(desktop.height() * scale));
+    if (frameSize.isEmpty()) {
+        release();
+        return false;
+    }
+    const qint64 frameBytes = qint64(frameSize.width()) * frameSize.height() * 4;
+    capacity = int(qMin<qint64>(qMax(1, capacity), qMax<qint64>(1, maxBytes / frameBytes)));
+
+    // All buffers up front; the grab writes into them in place. A buffer
+    // still shared with a frame taken earlier is replaced, not written.
+    // When memory runs out, the buffers allocated so far make the ring.
+    ring.resize(capacity);
+    for (int i = 0; i < ring.size(); ++i) {
+        QImage &buffer = ring[i];
+        if (buffer.size() != frameSize || buffer.format() != QImage::Format_RGB32 || !buffer.isDetached())
+            buffer = QImage(frameSize, QImage::Format_RGB32);
+        if (buffer.isNull()) {
+            ring.resize(i);
+            break;
+        }
+    }
+    if (ring.isEmpty()) {
+        qWarning() << "Burst: cannot allocate a frame of" << frameSize;
+        release();
+        return false;
+    }
+    times = QVector<qint64>(ring.size(), 0);
+
+    next = 0;
+    count = 0;
+    captured = 0;
+    dropped = 0;
+    lastTick = 0;
+    stoppedMs = 0;
+    clock.start();
+    timer.start(qMax(1, 1000 / rate));
+    captureFrame();
+    return true;
+}
+
+void BurstCapture::stop()
+{
+    if (!timer.isActive())
+        return;
+    timer.stop();
+    stoppedMs = clock.elapsed();
+    emit finished(stats());
+}
+
+void BurstCapture::release()
+{
+    timer.stop();
+    ring = QVector<QImage>();
+    times = QVector<qint64>();
+    next = 0;
+    count = 0;
+}
+
+void BurstCapture::captureFrame()
+{
+    PROFILE_SCOPE("burst.frame");
+
+    // Frame slots are fixed on the clock, so a slow grab shows up as
+    // skipped slots instead of a silently lower rate
+    const qint64 tick = clock.nsecsElapsed() * rate / 1000000000;
+    if (captured > 0 && tick <= lastTick)
+        return;
+    if (captured > 0)
+        dropped += int(tick - lastTick - 1);
+    lastTick = tick;
+
+    QImage &buffer = ring[next];
+    if (!ScreenCapture::grabInto(buffer)) {
+        stop();
+        return;
+    }
+    times[next] = clock.elapsed();
+    next = (next + 1) % ring.size();
+    count = qMin(count + 1, ring.size());
+    ++captured;
+    emit frameCaptured(captured);
+
+    if (limit > 0 && captured >= limit)
+        stop();
+}
+
+int BurstCapture::slot(int index) const
+{
+    const int oldest = count < ring.size() ? 0 : next;
+    return (oldest + index) % ring.size();
+}
+
+ImageBuffer BurstCapture::frame(int index) const
+{
+    if (index < 0 || index >= count)
+        return ImageBuffer();
+    return ImageBuffer(ring.at(slot(index)));
+}
+
+qint64 BurstCapture::frameTime(int index) const
+{
+    if (index < 0 || index >= count)
+        return -1;
+    return times.at(slot(index));
+}
+
+BurstCapture::Stats BurstCapture::stats() const
+{
+    Stats result;
+    result.captured = captured;
+    result.dropped = dropped;
+    result.elapsedMs = timer.isActive() ? clock.elapsed() : stoppedMs;
+    // Intervals between the first frame (at 0 ms) and the latest one
+    const qint64 lastMs = count > 0 ? frameTime(count - 1) : 0;
+    result.framesPerSecond = lastMs > 0 ? (captured - 1) * 1000.0 / lastMs : 0.0;
+    return result;
+}
+
+qint64 BurstCapture::memoryUsage() const
+{
+    qint64 bytes = 0;
+    for (const QImage &buffer : ring)
+        bytes += buffer.sizeInBytes();
+    return bytes;
+}
@@ -0,0 +1,89 @@
+#ifndef BURSTCAPTURE_H
+#define BURSTCAPTURE_H
+
+#include <QElapsedTimer>
+#include <QImage>
+#include <QObject>
+#include <QTimer>
+#include <QVector>
+#include "imagebuffer.h"
+
+// Burst mode: full-screen captures at a fixed rate into a ring of
+// preallocated frame buffers, for catching transient UI states.
+//
+// The ring is allocated once per start() (and kept while the capacity and
+// the desktop size stay the same, until release()), and every frame is
+// written in place through ScreenCapture::grabInto, so memory stays at
+// capacity × frame size however long the burst runs. The capacity is
+// capped so the ring stays within maxBytes(). A frame whose slot has come
+// round again before the previous capture finished is counted as dropped.
+class BurstCapture : public QObject
+{
+    Q_OBJECT
+
+public:
+    struct Stats {
+        int captured;           // frames written, including overwritten ones
+        int dropped;            // frame slots missed because a grab was too slow
+        qint64 elapsedMs;
+        double framesPerSecond; // achieved rate
+    };
+
+    // About 30 frames of a 4K desktop, 120 of a 1080p one
+    static const qint64 DefaultMaxBytes = qint64(1) << 30;
+
+    explicit BurstCapture(QObject *parent = nullptr);
+
+    void setMaxBytes(qint64 bytes) { maxBytes = qMax<qint64>(1, bytes); }
+
+    // Captures at 'framesPerSecond' into 'capacity' buffers, fewer when
+    // they would exceed the byte limit or cannot be allocated (see
+    // capacity()). Stops after 'frameLimit' frames, or only on stop() when
+    // it is 0; the ring then keeps the latest capacity() frames. Returns
+    // false, without starting, when not even one frame can be allocated.
+    bool start(int capacity, int framesPerSecond, int frameLimit);
+    void stop();
+    bool isRunning() const { return timer.isActive(); }
+    int capacity() const { return ring.size(); }
+
+    // Stops and frees the ring. Frames taken with frame() keep their
+    // pixels: each shares its own buffer, not the ring.
+    void release();
+
+    // Frames of the last burst, oldest first. A frame shares the ring's
+    // pixels; the next burst copies that one slot out before reusing it.
+    int frameCount() const { return count; }
+    ImageBuffer frame(int index) const;
+    qint64 frameTime(int index) const;     // milliseconds since start()
+
+    Stats stats() const;
+    qint64 memoryUsage() const;
+
+signals:
+    void frameCaptured(int count);
+    void finished(const BurstCapture::Stats &stats);
+
+private slots:
+    void captureFrame();
+
+private:
+    int slot(int index) const;
+
+    QTimer timer;
+    QElapsedTimer clock;
+    QVector<QImage> ring;
+    QVector<qint64> times;
+    qint64 maxBytes;
+    int rate;
+    int limit;
+    int next;           // ring slot for the next frame
+    int count;          // valid frames in the ring
+    int captured;
+    int dropped;
+    qint64 lastTick;    // frame slot number of the last capture
+    qint64 stoppedMs;
+};
+
+Q_DECLARE_METATYPE(BurstCapture::Stats)
+
+#endif // BURSTCAPTURE_H
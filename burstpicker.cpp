@@ -0,0 +1,62 @@
+#include "burstpicker.h"
+#include "burstcapture.h"
+#include <QDialogButtonBox>
+#include <QLabel>
+#include <QSlider>
+#include <QVBoxLayout>
+
+BurstPicker::BurstPicker(const BurstCapture *burst, QWidget *parent)
+    : QDialog(parent),
+      burst(burst)
+{
+    setWindowTitle("Выбор кадра серии");
+
+    const BurstCapture::Stats stats = burst->stats();
+    QLabel *statsLabel = new QLabel(
+        QString("Снято кадров: %1 • %2 к/с • пропущено: %3 • память: %4 МБ")
+            .arg(stats.captured)
+            .arg(stats.framesPerSecond, 0, 'f', 1)
+            .arg(stats.dropped)
+            .arg(burst->memoryUsage() / (1024 * 1024)), this);
+
+    frameLabel = new QLabel(this);
+    frameLabel->setAlignment(Qt::AlignCenter);
+    frameLabel->setMinimumSize(640, 360);
+
+    slider = new QSlider(Qt::Horizontal, this);
+    slider->setRange(0, qMax(0, burst->frameCount() - 1));
+    slider->setValue(slider->maximum());
+    connect(slider, &QSlider::valueChanged, this, &BurstPicker::showFrame);
+
+    infoLabel = new QLabel(this);
+
+    QDialogButtonBox *buttons = new QDialogButtonBox(QDialogButtonBox::Ok | QDialogButtonBox::Cancel, this);
+    connect(buttons, &QDialogButtonBox::accepted, this, &QDialog::accept);
+    connect(buttons, &QDialogButtonBox::rejected, this, &QDialog::reject);
+
+    QVBoxLayout *layout = new QVBoxLayout(this);
+    layout->addWidget(statsLabel);
+    layout->addWidget(frameLabel, 1);
+    layout->addWidget(slider);
+    layout->addWidget(infoLabel);
+    layout->addWidget(buttons);
+
+    showFrame(slider->value());
+}
+
+int BurstPicker::selectedFrame() const
+{
+    return slider->value();
+}
+
+void BurstPicker::showFrame(int index)
+{
+    const QImage frame = burst->frame(index).image();
+    if (frame.isNull())
+        return;
+    // Fast scaling: the slider is dragged across frames of desktop size
+    frameLabel->setPixmap(QPixmap::fromImage(
+        frame.scaled(frameLabel->size(), Qt::KeepAspectRatio, Qt::FastTransformation)));
+    infoLabel->setText(QString("Кадр %1 из %2 • +%3 мс")
+        .arg(index + 1).arg(burst->frameCount()).arg(burst->frameTime(index)));
+}
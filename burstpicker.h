@@ -0,0 +1,31 @@
+#ifndef BURSTPICKER_H
+#define BURSTPICKER_H
+
+#include <QDialog>
+
+class BurstCapture;
+class QLabel;
+class QSlider;
+
+// Chooses one frame of a finished burst for the preview and the editor.
+// Shows the achieved rate and the dropped frames of the burst.
+class BurstPicker : public QDialog
+{
+    Q_OBJECT
+
+public:
+    explicit BurstPicker(const BurstCapture *burst, QWidget *parent = nullptr);
+
+    int selectedFrame() const;
+
+private slots:
+    void showFrame(int index);
+
+private:
+    const BurstCapture *burst;
+    QSlider *slider;
+    QLabel *frameLabel;
+    QLabel *infoLabel;
+};
+
+#endif // BURSTPICKER_H
@@ -0,0 +1,79 @@
+#include "capturesource.h"
+#include <QGuiApplication>
+#include <QPixmap>
+#include <QRegularExpression>
+#include <QScreen>
+#include <QStringList>
+
+QVector<CaptureSource::Screen> QtCaptureSource::screens() const
+{
+    QVector<Screen> result;
+    for (QScreen *screen : QGuiApplication::screens()) {
+        Screen info;
+        info.name = screen->name();
+        info.geometry = screen->geometry();
+        info.devicePixelRatio = screen->devicePixelRatio();
+        result.append(info);
+    }
+    return result;
+}
+
+QImage QtCaptureSource::grabScreen(int index, const QRect &area)
+{
+    const QList<QScreen *> all = QGuiApplication::screens();
+    if (index < 0 || index >= all.size())
+        return QImage();
+
+    QImage image = all.at(index)->grabWindow(0, area.x(), area.y(), area.width(), area.height()).toImage();
+    image.setDevicePixelRatio(1.0);
+    return image;
+}
+
+SyntheticCaptureSource::SyntheticCaptureSource(const QVector<Screen> &screens)
+    : fakeScreens(screens)
+{
+}
+
+QRgb SyntheticCaptureSource::expectedPixel(int index, int x, int y)
+{
+    return qRgb((index * 80 + 40) & 0xff, (x >> 4) & 0xff, (y >> 4) & 0xff);
+}
+
+QVector<CaptureSource::Screen> SyntheticCaptureSource::parseScreens(const QString &spec)
+{
+    const QRegularExpression pattern("^(\\d+)x(\\d+)(?:@(\\d+(?:\\.\\d+)?))?$");
+    QVector<Screen> result;
+    int left = 0;
+    for (const QString &entry : spec.split(',', QString::SkipEmptyParts)) {
+        const QRegularExpressionMatch match = pattern.match(entry.trimmed());
+        if (!match.hasMatch())
+            return QVector<Screen>();
+        Screen screen;
+        screen.name = QString("synthetic-%1").arg(result.size());
+        screen.geometry = QRect(left, 0, match.captured(1).toInt(), match.captured(2).toInt());
+        screen.devicePixelRatio = match.captured(3).isEmpty() ? 1.0 : match.captured(3).toDouble();
+        if (screen.geometry.isEmpty() || screen.devicePixelRatio <= 0)
+            return QVector<Screen>();
+        left += screen.geometry.width();
+        result.append(screen);
+    }
+    return result;
+}
+
+QImage SyntheticCaptureSource::grabScreen(int index, const QRect &area)
+{
+    if (index < 0 || index >= fakeScreens.size())
+        return QImage();
+
+    const qreal ratio = fakeScreens.at(index).devicePixelRatio;
+    const QRect device(qRound(area.x() * ratio), qRound(area.y() * ratio),
+                       qRound(area.width() * ratio), qRound(area.height() * ratio));
+
+    QImage image(device.size(), QImage::Format_RGB32);
+    for (int y = 0; y < device.height(); ++y) {
+        QRgb *line = reinterpret_cast<QRgb *>(image.scanLine(y));
+        for (int x = 0; x < device.width(); ++x)
+            line[x] = expectedPixel(index, device.x() + x, device.y() + y);
+    }
+    return image;
+}
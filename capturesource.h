@@ -0,0 +1,66 @@
+#ifndef CAPTURESOURCE_H
+#define CAPTURESOURCE_H
+
+#include <QImage>
+#include <QRect>
+#include <QString>
+#include <QVector>
+
+// Where screen pixels come from. ScreenCapture composites the screens of
+// the active source into one virtual-desktop image.
+class CaptureSource
+{
+public:
+    struct Screen {
+        QString name;
+        QRect geometry;             // logical pixels, virtual-desktop coordinates
+        qreal devicePixelRatio;
+    };
+
+    virtual ~CaptureSource() {}
+
+    virtual QVector<Screen> screens() const = 0;
+
+    // Pixels of 'area' of screen 'index' at device resolution. 'area' is in
+    // logical pixels relative to the screen's top-left corner.
+    virtual QImage grabScreen(int index, const QRect &area) = 0;
+
+    // True when grabScreen() may run for several screens at once on worker
+    // threads; otherwise ScreenCapture calls it on the calling thread only
+    virtual bool isThreadSafe() const { return false; }
+};
+
+// QScreen::grabWindow(0) for every QGuiApplication::screens() entry.
+// Pixmaps must be created on the GUI thread, so grabs are sequential and
+// only the conversion and composition run in parallel.
+class QtCaptureSource : public CaptureSource
+{
+public:
+    QVector<Screen> screens() const override;
+    QImage grabScreen(int index, const QRect &area) override;
+};
+
+// Synthetic screens for headless tests and benchmarks. Every screen is
+// filled with a pattern that encodes its index and the device pixel
+// position, see expectedPixel().
+class SyntheticCaptureSource : public CaptureSource
+{
+public:
+    explicit SyntheticCaptureSource(const QVector<Screen> &screens);
+
+    QVector<Screen> screens() const override { return fakeScreens; }
+    QImage grabScreen(int index, const QRect &area) override;
+    bool isThreadSafe() const override { return true; }
+
+    // Pixel of screen 'index' at device pixel (x, y) of the whole screen
+    static QRgb expectedPixel(int index, int x, int y);
+
+    // "WxH[@ratio],..." in logical pixels, laid out left to right from the
+    // origin, e.g. "1920x1080@2,1920x1080". Empty on a malformed entry.
+    static QVector<Screen> parseScreens(const QString &spec);
+
+private:
+    QVector<Screen> fakeScreens;
+};
+
+#endif // CAPTURESOURCE_H
@@ -0,0 +1,276 @@
+#include "capturestore.h"
+#include <QElapsedTimer>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#  define STORE_HAVE_SSE2
+#  include <emmintrin.h>
+#endif
+
+namespace {
+
+// Two 64-bit lanes, 16 bytes (four pixels) per step. Each lane adds the
+// product of the low and high halves of (data ^ key) plus the data itself;
+// the key advances every step, so equal pixels at different positions
+// contribute differently.
+const quint64 kKeyStart[2] = { 0x9E3779B97F4A7C15ull, 0xC2B2AE3D27D4EB4Full };
+const quint64 kKeyStep[2] = { 0x165667B19E3779F9ull, 0x27D4EB2F165667C5ull };
+
+inline void accumulate(quint64 acc[2], quint64 key[2], const quint64 data[2])
+{
+    for (int lane = 0; lane < 2; ++lane) {
+        const quint64 mixed = data[lane] ^ key[lane];
+        acc[lane] += (mixed & 0xffffffffull) * (mixed >> 32) + data[lane];
+        key[lane] += kKeyStep[lane];
+    }
+}
+
+inline quint64 finalize(const quint64 acc[2], int width, int height)
+{
+    quint64 h = acc[0] ^ ((acc[1] << 29) | (acc[1] >> 35))
+              ^ (quint64(quint32(width)) << 32 | quint32(height));
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdull;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ull;
+    h ^= h >> 33;
+    return h;
+}
+
+// Last pixels of a row that do not fill a step, zero-padded
+inline void accumulateTail(quint64 acc[2], quint64 key[2], const uchar *row, int pixels)
+{
+    quint64 data[2] = { 0, 0 };
+    memcpy(data, row, size_t(pixels) * 4);
+    accumulate(acc, key, data);
+}
+
+// Byte comparison of the same tile in two RGB32 images of one size
+bool sameTile(const QImage &a, const QImage &b, const QRect &rect)
+{
+    const size_t rowBytes = size_t(rect.width()) * 4;
+    for (int y = rect.top(); y <= rect.bottom(); ++y) {
+        if (memcmp(a.constScanLine(y) + rect.x() * 4, b.constScanLine(y) + rect.x() * 4, rowBytes) != 0)
+            return false;
+    }
+    return true;
+}
+
+} // namespace
+
+CaptureStore::CaptureStore(int keyframeInterval)
+    : interval(qMax(1, keyframeInterval)),
+      lastKeyframe(-1),
+      storedBytes(0),
+      lastRebuildNs(0)
+{
+}
+
+void CaptureStore::clear()
+{
+    frames.clear();
+    lastKeyframe = -1;
+    storedBytes = 0;
+    lastRebuildNs = 0;
+}
+
+quint64 CaptureStore::hashTile(const uchar *bits, int bytesPerLine, int width, int height)
+{
+    quint64 acc[2] = { 0, 0 };
+    quint64 key[2] = { kKeyStart[0], kKeyStart[1] };
+    const int steps = width / 4;
+    const int tail = width % 4;
+
+#ifdef STORE_HAVE_SSE2
+    __m128i vacc = _mm_setzero_si128();
+    __m128i vkey = _mm_loadu_si128(reinterpret_cast<const __m128i *>(kKeyStart));
+    const __m128i vstep = _mm_loadu_si128(reinterpret_cast<const __m128i *>(kKeyStep));
+    for (int y = 0; y < height; ++y) {
+        const uchar *row = bits + qptrdiff(y) * bytesPerLine;
+        for (int i = 0; i < steps; ++i) {
+            const __m128i data = _mm_loadu_si128(reinterpret_cast<const __m128i *>(row + i * 16));
+            const __m128i mixed = _mm_xor_si128(data, vkey);
+            const __m128i product = _mm_mul_epu32(mixed, _mm_srli_epi64(mixed, 32));
+            vacc = _mm_add_epi64(vacc, _mm_add_epi64(product, data));
+            vkey = _mm_add_epi64(vkey, vstep);
+        }
+        if (tail) {
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(acc), vacc);
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(key), vkey);
+            accumulateTail(acc, key, row + steps * 16, tail);
+            vacc = _mm_loadu_si128(reinterpret_cast<const __m128i *>(acc));
+            vkey = _mm_loadu_si128(reinterpret_cast<const __m128i *>(key));
+        }
+    }
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(acc), vacc);
+#else
+    for (int y = 0; y < height; ++y) {
+        const uchar *row = bits + qptrdiff(y) * bytesPerLine;
+        for (int i = 0; i < steps; ++i) {
+            quint64 data[2];
+            memcpy(data, row + i * 16, sizeof(data));
+            accumulate(acc, key, data);
+        }
+        if (tail)
+            accumulateTail(acc, key, row + steps * 16, tail);
+    }
+#endif
+    return finalize(acc, width, height);
+}
+
+int CaptureStore::tileCount(const QSize &size) const
+{
+    const int columns = (size.width() + TileSize - 1) / TileSize;
+    const int rows = (size.height() + TileSize - 1) / TileSize;
+    return columns * rows;
+}
+
+QRect CaptureStore::tileRect(const QSize &size, int index) const
+{
+    const int columns = (size.width() + TileSize - 1) / TileSize;
+    return QRect((index % columns) * TileSize, (index / columns) * TileSize, TileSize, TileSize)
+               .intersected(QRect(QPoint(0, 0), size));
+}
+
+void CaptureStore::appendKeyframe(const QImage &image, const QVector<quint64> &hashes)
+{
+    Frame frame;
+    frame.keyframe = frames.size();
+    frame.image = image;
+    frame.hashes = hashes;
+    frame.bytes = image.sizeInBytes() + hashes.size() * qint64(sizeof(quint64));
+    storedBytes += frame.bytes;
+    lastKeyframe = frame.keyframe;
+    frames.append(frame);
+}
+
+int CaptureStore::append(const QImage &capture)
+{
+    const QImage image = capture.format() == QImage::Format_RGB32
+        ? capture : capture.convertToFormat(QImage::Format_RGB32);
+
+    const int tiles = tileCount(image.size());
+    QVector<quint64> hashes(tiles);
+    for (int i = 0; i < tiles; ++i) {
+        const QRect rect = tileRect(image.size(), i);
+        hashes[i] = hashTile(image.constScanLine(rect.y()) + rect.x() * 4, image.bytesPerLine(),
+                             rect.width(), rect.height());
+    }
+
+    const bool needsKeyframe = lastKeyframe < 0
+        || frames.at(lastKeyframe).image.size() != image.size()
+        || frames.size() - lastKeyframe >= interval;
+    if (needsKeyframe) {
+        appendKeyframe(image, hashes);
+        return frames.size() - 1;
+    }
+
+    // Equal hashes are confirmed against the keyframe's pixels; the tiles
+    // are in cache by then, so this costs about one more pass over memory
+    const Frame &key = frames.at(lastKeyframe);
+    QVector<int> changed;
+    for (int i = 0; i < tiles; ++i) {
+        if (hashes.at(i) != key.hashes.at(i) || !sameTile(image, key.image, tileRect(image.size(), i)))
+            changed.append(i);
+    }
+    if (changed.size() * 2 > tiles) {
+        appendKeyframe(image, hashes);
+        return frames.size() - 1;
+    }
+
+    Frame frame;
+    frame.keyframe = lastKeyframe;
+    frame.bytes = 0;
+    for (int index : changed) {
+        const QRect rect = tileRect(image.size(), index);
+        const int rowBytes = rect.width() * 4;
+        Tile tile;
+        tile.index = index;
+        tile.pixels.resize(rowBytes * rect.height());
+        char *out = tile.pixels.data();
+        for (int y = rect.top(); y <= rect.bottom(); ++y) {
+            memcpy(out, image.constScanLine(y) + rect.x() * 4, size_t(rowBytes));
+            out += rowBytes;
+        }
+        frame.bytes += tile.pixels.size() + qint64(sizeof(Tile));
+        frame.tiles.append(tile);
+    }
+    storedBytes += frame.bytes;
+    frames.append(frame);
+    return frames.size() - 1;
+}
+
+int CaptureStore::dropOldestKeyframe()
+{
+    if (frames.isEmpty())
+        return 0;
+
+    // Frames of one keyframe are contiguous: deltas always refer to the
+    // latest keyframe
+    int dropped = 1;
+    while (dropped < frames.size() && frames.at(dropped).keyframe == 0)
+        ++dropped;
+    for (int i = 0; i < dropped; ++i)
+        storedBytes -= frames.at(i).bytes;
+    frames.remove(0, dropped);
+
+    for (Frame &frame : frames)
+        frame.keyframe -= dropped;
+    lastKeyframe = frames.isEmpty() ? -1 : lastKeyframe - dropped;
+    return dropped;
+}
+
+bool CaptureStore::isKeyframe(int index) const
+{
+    return index >= 0 && index < frames.size() && frames.at(index).keyframe == index;
+}
+
+int CaptureStore::storedTiles(int index) const
+{
+    if (index < 0 || index >= frames.size())
+        return 0;
+    if (isKeyframe(index))
+        return tileCount(frames.at(index).image.size());
+    return frames.at(index).tiles.size();
+}
+
+QImage CaptureStore::frame(int index) const
+{
+    if (index < 0 || index >= frames.size())
+        return QImage();
+    const Frame &delta = frames.at(index);
+    const QImage &key = frames.at(delta.keyframe).image;
+    if (isKeyframe(index))
+        return key;
+
+    QElapsedTimer timer;
+    timer.start();
+    QImage image = key.copy();
+    for (const Tile &tile : delta.tiles) {
+        const QRect rect = tileRect(image.size(), tile.index);
+        const int rowBytes = rect.width() * 4;
+        const char *in = tile.pixels.constData();
+        for (int y = rect.top(); y <= rect.bottom(); ++y) {
+            memcpy(image.scanLine(y) + rect.x() * 4, in, size_t(rowBytes));
+            in += rowBytes;
+        }
+    }
+    lastRebuildNs = timer.nsecsElapsed();
+    return image;
+}
+
+CaptureStore::Stats CaptureStore::stats() const
+{
+    Stats result;
+    result.frames = frames.size();
+    result.keyframes = 0;
+    result.rawBytes = 0;
+    for (int i = 0; i < frames.size(); ++i) {
+        if (isKeyframe(i))
+            ++result.keyframes;
+        result.rawBytes += frames.at(frames.at(i).keyframe).image.sizeInBytes();
+    }
+    result.storedBytes = storedBytes;
+    result.compressionRatio = storedBytes > 0 ? double(result.rawBytes) / storedBytes : 1.0;
+    result.lastRebuildNs = lastRebuildNs;
+    return result;
+}
@@ -0,0 +1,91 @@
+#ifndef CAPTURESTORE_H
+#define CAPTURESTORE_H
+
+#include <QByteArray>
+#include <QImage>
+#include <QRect>
+#include <QVector>
+
+// Sequence of captures of the same desktop, stored as keyframes plus the
+// tiles that changed since them.
+//
+// Every frame is split into TileSize x TileSize tiles and each tile is
+// hashed with a 64-bit SIMD hash. A keyframe keeps its pixels and its tile
+// hashes; a later frame keeps only the tiles that differ from its
+// keyframe's. A differing hash marks a tile as changed right away, an
+// equal one is confirmed with memcmp, so a collision never loses pixels.
+// Deltas are always against the keyframe, never the previous frame, so
+// rebuilding any frame is one keyframe copy plus its own tiles.
+//
+// A new keyframe starts when the size changes, after KeyframeInterval
+// frames, or when more than half of the tiles changed, so deltas never grow
+// past half a frame. Frames are RGB32.
+class CaptureStore
+{
+public:
+    static const int TileSize = 64;
+    static const int DefaultKeyframeInterval = 30;
+
+    struct Stats {
+        int frames;
+        int keyframes;
+        qint64 rawBytes;        // frames × full frame size
+        qint64 storedBytes;     // keyframes + changed tiles
+        double compressionRatio;
+        qint64 lastRebuildNs;   // last frame() that was not a keyframe
+    };
+
+    explicit CaptureStore(int keyframeInterval = DefaultKeyframeInterval);
+
+    void clear();
+
+    // Appends a capture; returns its index
+    int append(const QImage &frame);
+
+    // Drops the oldest keyframe with the frames stored against it, so a
+    // bounded history can evict its oldest captures without touching the
+    // rest. Returns the number of frames dropped; every later index moves
+    // down by that many.
+    int dropOldestKeyframe();
+
+    int count() const { return frames.size(); }
+    bool isKeyframe(int index) const;
+    // Tiles stored for frame 'index'; all of them for a keyframe
+    int storedTiles(int index) const;
+
+    // Rebuilt capture 'index'; a keyframe shares its stored pixels
+    QImage frame(int index) const;
+
+    Stats stats() const;
+    qint64 memoryUsage() const { return storedBytes; }
+
+    // 64-bit hash of a block of 32-bit pixels. SSE2 when available, with
+    // results identical to the portable version.
+    static quint64 hashTile(const uchar *bits, int bytesPerLine, int width, int height);
+
+private:
+    struct Tile {
+        int index;          // row-major tile number within the frame
+        QByteArray pixels;  // raw rows
+    };
+
+    struct Frame {
+        int keyframe;               // index of this frame's keyframe
+        QImage image;               // keyframes only
+        QVector<quint64> hashes;    // keyframes only, one per tile
+        QVector<Tile> tiles;        // delta frames only
+        qint64 bytes;
+    };
+
+    QRect tileRect(const QSize &size, int index) const;
+    int tileCount(const QSize &size) const;
+    void appendKeyframe(const QImage &image, const QVector<quint64> &hashes);
+
+    QVector<Frame> frames;
+    int interval;
+    int lastKeyframe;
+    qint64 storedBytes;
+    mutable qint64 lastRebuildNs;
+};
+
+#endif // CAPTURESTORE_H
@@ -0,0 +1,55 @@
+#include "clipboarddata.h"
+#include "pngencoder.h"
+#include "profiler.h"
+#include <QBuffer>
+#include <QImageWriter>
+
+namespace {
+const char kImageMime[] = "application/x-qt-image";
+const char kPngMime[] = "image/png";
+const char kBmpMime[] = "image/bmp";
+}
+
+ClipboardImageData::ClipboardImageData(const QImage &image)
+    : image(image)
+{
+}
+
+QStringList ClipboardImageData::formats() const
+{
+    return QStringList() << kImageMime << kPngMime << kBmpMime;
+}
+
+bool ClipboardImageData::hasFormat(const QString &mimeType) const
+{
+    return mimeType == kImageMime || mimeType == kPngMime || mimeType == kBmpMime;
+}
+
+QVariant ClipboardImageData::retrieveData(const QString &mimeType, QVariant::Type type) const
+{
+    // The platform converts the raw image itself (e.g. to CF_DIB on Windows)
+    if (mimeType == kImageMime)
+        return image;
+
+    if (mimeType != kPngMime && mimeType != kBmpMime)
+        return QMimeData::retrieveData(mimeType, type);
+
+    auto cached = encoded.constFind(mimeType);
+    if (cached != encoded.constEnd())
+        return cached.value();
+
+    // Runs on the GUI thread while the paste target waits for the data, so
+    // PNG uses the fastest level on all cores
+    PROFILE_SCOPE("clipboard.encode");
+    QByteArray bytes;
+    QBuffer buffer(&bytes);
+    buffer.open(QIODevice::WriteOnly);
+    const bool ok = mimeType == kPngMime
+        ? PngEncoder::write(image, &buffer, PngEncoder::FastestLevel)
+        : QImageWriter(&buffer, "bmp").write(image);
+    if (!ok)
+        return QVariant();
+
+    encoded.insert(mimeType, bytes);
+    return bytes;
+}
@@ -0,0 +1,37 @@
+#ifndef CLIPBOARDDATA_H
+#define CLIPBOARDDATA_H
+
+#include <QHash>
+#include <QImage>
+#include <QMimeData>
+
+// Clipboard contents for a capture that encode on demand.
+//
+// QClipboard::setImage() hands the platform an image that it converts to
+// every advertised format while copying. This class only advertises the
+// formats: the raw QImage, PNG and BMP. A format is encoded the first time
+// a paste target asks for it in retrieveData() and cached after that;
+// formats nobody pastes are never encoded. Copying only shares the image.
+class ClipboardImageData : public QMimeData
+{
+    Q_OBJECT
+
+public:
+    explicit ClipboardImageData(const QImage &image);
+
+    QStringList formats() const override;
+    bool hasFormat(const QString &mimeType) const override;
+
+    // Formats encoded so far; the benchmark checks that nothing is encoded
+    // before a paste asks for it
+    QStringList encodedFormats() const { return encoded.keys(); }
+
+protected:
+    QVariant retrieveData(const QString &mimeType, QVariant::Type type) const override;
+
+private:
+    QImage image;
+    mutable QHash<QString, QByteArray> encoded;
+};
+
+#endif // CLIPBOARDDATA_H
@@ -0,0 +1,190 @@
+#include "commandline.h"
+#include "blurengine.h"
+#include "imagebuffer.h"
+#include "qoicodec.h"
+#include "savequeue.h"
+#include "screencapture.h"
+#include <QCommandLineParser>
+#include <QFile>
+#include <QFileInfo>
+#include <QGuiApplication>
+#include <QImageReader>
+#include <QPainter>
+#include <QRegularExpression>
+#include <QTextStream>
+#include <cstdio>
+#ifdef Q_OS_WIN
+#  include <fcntl.h>
+#  include <io.h>
+#endif
+
+namespace {
+
+// Same threshold as ImageEditor: larger regions are blurred in bands
+const qint64 kParallelBlurPixels = 1024 * 1024;
+
+bool parseRect(const QString &text, QRect *rect)
+{
+    static const QRegularExpression pattern("^(-?\\d+),(-?\\d+),(\\d+),(\\d+)$");
+    const QRegularExpressionMatch match = pattern.match(text);
+    if (!match.hasMatch())
+        return false;
+    *rect = QRect(match.captured(1).toInt(), match.captured(2).toInt(),
+                  match.captured(3).toInt(), match.captured(4).toInt());
+    return !rect->isEmpty();
+}
+
+// "x,y,w,h:r"
+bool parseBlur(const QString &text, QRect *rect, int *radius)
+{
+    const int colon = text.lastIndexOf(':');
+    if (colon < 0)
+        return false;
+    bool ok = false;
+    *radius = text.mid(colon + 1).toInt(&ok);
+    return ok && *radius > 0 && parseRect(text.left(colon), rect);
+}
+
+int fail(const QString &message, int code)
+{
+    QTextStream err(stderr);
+    err << "ScreenshotTool: " << message << "\n";
+    err.flush();
+    return code;
+}
+
+} // namespace
+
+namespace CommandLine {
+
+bool isRequested(int argc, char *argv[])
+{
+    // Whole option names, alone or as "--out=file"; "--output" is not one
+    static const char *const options[] = { "--capture", "--input", "--out" };
+    for (int i = 1; i < argc; ++i) {
+        const QByteArray arg(argv[i]);
+        for (const char *option : options) {
+            if (arg == option || arg.startsWith(QByteArray(option) + '='))
+                return true;
+        }
+    }
+    return false;
+}
+
+int run(QGuiApplication &app)
+{
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Headless screen capture and processing");
+    parser.addHelpOption();
+    parser.addOptions({
+        { "capture", "Capture 'full' or 'rect:x,y,w,h' of the virtual desktop.", "what" },
+        { "input", "Process an image file instead of capturing.", "file" },
+        { "blur", "Blur a region with radius r; may be repeated.", "x,y,w,h:r" },
+        { "blur-quality", "'box' or 'gaussian' (default).", "quality", "gaussian" },
+        { "crop", "Crop to a region.", "x,y,w,h" },
+        { "out", "Output file, or '-' for stdout.", "file" },
+        { "format", "Image format; default from the suffix, png for stdout.", "format" },
+        { "quality", "Encoder quality 0-100.", "quality", "-1" },
+    });
+    parser.process(app);
+
+    if (parser.isSet("capture") == parser.isSet("input"))
+        return fail("exactly one of --capture or --input is required", 1);
+    if (!parser.isSet("out"))
+        return fail("--out is required", 1);
+
+    // Source image
+    ImageBuffer image;
+    if (parser.isSet("capture")) {
+        const QString what = parser.value("capture");
+        QRect area;
+        if (what.startsWith("rect:")) {
+            if (!parseRect(what.mid(5), &area))
+                return fail("invalid --capture rectangle: " + what, 1);
+        } else if (what != "full") {
+            return fail("--capture expects 'full' or 'rect:x,y,w,h'", 1);
+        }
+        image = ScreenCapture::grab(area);
+        if (image.isNull())
+            return fail("screen capture failed", 2);
+    } else {
+        const QString input = parser.value("input");
+        QFile file(input);
+        if (!file.open(QIODevice::ReadOnly))
+            return fail(input + ": " + file.errorString(), 2);
+        // QOI is not a Qt image format; everything else goes to QImageReader
+        QString error;
+        QImage loaded;
+        if (QoiCodec::canRead(file.peek(4))) {
+            loaded = QoiCodec::read(&file, &error);
+        } else {
+            QImageReader reader(&file);
+            loaded = reader.read();
+            error = reader.errorString();
+        }
+        if (loaded.isNull())
+            return fail(input + ": " + error, 2);
+        image = ImageBuffer(loaded);
+    }
+
+    // Blurs, in capture coordinates
+    const BlurEngine::Quality quality = parser.value("blur-quality") == "box"
+        ? BlurEngine::Quality::Box : BlurEngine::Quality::Gaussian;
+    for (const QString &blur : parser.values("blur")) {
+        QRect area;
+        int radius = 0;
+        if (!parseBlur(blur, &area, &radius))
+            return fail("invalid --blur: " + blur, 1);
+        area = area.intersected(image.rect());
+        if (area.isEmpty())
+            continue;
+
+        QImage section = image.region(area).image();
+        if (qint64(area.width()) * area.height() < kParallelBlurPixels)
+            BlurEngine::blur(section, radius, quality);
+        else
+            BlurEngine::blurParallel(section, radius, quality);
+        QPainter painter(&image.edit());
+        painter.drawImage(area.topLeft(), section);
+    }
+
+    // Crop: a view, so nothing is copied before encoding
+    if (parser.isSet("crop")) {
+        QRect area;
+        if (!parseRect(parser.value("crop"), &area))
+            return fail("invalid --crop: " + parser.value("crop"), 1);
+        image = image.region(area);
+        if (image.isNull() || image.rect().isEmpty())
+            return fail("--crop lies outside the image", 1);
+    }
+
+    // Output
+    const QString out = parser.value("out");
+    const int encoderQuality = parser.value("quality").toInt();
+    QByteArray format = parser.value("format").toLower().toLatin1();
+
+    if (out == "-") {
+        if (format.isEmpty())
+            format = "png";
+#ifdef Q_OS_WIN
+        // Keep the C runtime from turning \n into \r\n inside the image
+        _setmode(_fileno(stdout), _O_BINARY);
+#endif
+        QFile stdoutFile;
+        if (!stdoutFile.open(stdout, QIODevice::WriteOnly))
+            return fail("cannot open stdout", 2);
+        QString error;
+        if (!SaveQueue::encode(image.image(), &stdoutFile, format, encoderQuality, &error))
+            return fail(error, 2);
+        return 0;
+    }
+
+    if (format.isEmpty() && QFileInfo(out).suffix().isEmpty())
+        format = "png";
+    const SaveResult result = SaveQueue::write(image.image(), out, format, encoderQuality);
+    if (!result.ok)
+        return fail(out + ": " + result.error, 2);
+    return 0;
+}
+
+} // namespace CommandLine
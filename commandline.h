@@ -0,0 +1,27 @@
+#ifndef COMMANDLINE_H
+#define COMMANDLINE_H
+
+class QGuiApplication;
+
+// Headless mode for scripts:
+//
+//   ScreenshotTool --capture full|rect:x,y,w,h | --input file
+//                  [--blur x,y,w,h:r ...] [--blur-quality box|gaussian]
+//                  [--crop x,y,w,h] --out file.png|- [--format png|jpg] [--quality 0-100]
+//
+// Uses the same capture, blur and encoding code as the window but creates
+// no widgets and exits as soon as the image is written. Blurs are applied
+// first, then the crop; all coordinates are in captured-image pixels.
+// Works on the offscreen platform (QT_QPA_PLATFORM=offscreen).
+namespace CommandLine {
+
+// True when the arguments select the headless mode
+bool isRequested(int argc, char *argv[]);
+
+// Returns the process exit code: 0 on success, 1 for bad arguments,
+// 2 when capturing, reading or writing failed
+int run(QGuiApplication &app);
+
+} // namespace CommandLine
+
+#endif // COMMANDLINE_H
@@ -0,0 +1,109 @@
+#include "historygallery.h"
+#include "historystore.h"
+#include <QAbstractListModel>
+#include <QDialogButtonBox>
+#include <QLabel>
+#include <QListView>
+#include <QPixmap>
+#include <QPushButton>
+#include <QVBoxLayout>
+
+namespace {
+
+const int kIdRole = Qt::UserRole;
+
+// Newest capture in the first row. The view asks only for the rows it
+// shows, so a pixmap is made from the atlas per visible thumbnail.
+class HistoryModel : public QAbstractListModel
+{
+public:
+    HistoryModel(const HistoryStore *store, QObject *parent)
+        : QAbstractListModel(parent), store(store) {}
+
+    int rowCount(const QModelIndex &parent = QModelIndex()) const override
+    {
+        return parent.isValid() ? 0 : store->count();
+    }
+
+    QVariant data(const QModelIndex &index, int role) const override
+    {
+        if (!index.isValid() || index.row() >= store->count())
+            return QVariant();
+        const int entryIndex = store->count() - 1 - index.row();
+        const HistoryStore::Entry &entry = store->entry(entryIndex);
+        switch (role) {
+        case Qt::DisplayRole:
+            // Near-duplicates of the capture before are marked with "≈"
+            return (isNearDuplicate(entryIndex) ? "≈ " : "")
+                + entry.time.toString("dd.MM.yyyy hh:mm:ss");
+        case Qt::DecorationRole:
+            return QPixmap::fromImage(store->thumbnail(entryIndex));
+        case Qt::ToolTipRole:
+            return QString("%1x%2 • %3 КБ")
+                .arg(entry.size.width()).arg(entry.size.height()).arg(entry.bytes / 1024);
+        case kIdRole:
+            return entry.id;
+        default:
+            return QVariant();
+        }
+    }
+
+private:
+    bool isNearDuplicate(int entryIndex) const
+    {
+        if (entryIndex == 0)
+            return false;
+        const HistoryStore::Entry &entry = store->entry(entryIndex);
+        const HistoryStore::Entry &previous = store->entry(entryIndex - 1);
+        return entry.size == previous.size
+            && PerceptualHash::distance(entry.hash, previous.hash) <= PerceptualHash::NearDuplicateDistance;
+    }
+
+    const HistoryStore *store;
+};
+
+} // namespace
+
+HistoryGallery::HistoryGallery(const HistoryStore *store, QWidget *parent)
+    : QDialog(parent),
+      store(store)
+{
+    setWindowTitle("Архив снимков");
+    resize(760, 520);
+
+    QLabel *infoLabel = new QLabel(QString("Снимков: %1 • на диске: %2 МБ")
+        .arg(store->count())
+        .arg(store->totalBytes() / (1024 * 1024)), this);
+
+    view = new QListView(this);
+    view->setViewMode(QListView::IconMode);
+    view->setMovement(QListView::Static);
+    view->setResizeMode(QListView::Adjust);
+    view->setIconSize(QSize(HistoryStore::ThumbnailWidth, HistoryStore::ThumbnailHeight));
+    view->setGridSize(QSize(HistoryStore::ThumbnailWidth + 24, HistoryStore::ThumbnailHeight + 40));
+    // Uniform items and batched layout keep thousands of rows from being
+    // measured up front
+    view->setUniformItemSizes(true);
+    view->setLayoutMode(QListView::Batched);
+    view->setModel(new HistoryModel(store, view));
+    connect(view, &QListView::doubleClicked, this, &QDialog::accept);
+
+    QDialogButtonBox *buttons = new QDialogButtonBox(QDialogButtonBox::Open | QDialogButtonBox::Cancel, this);
+    QPushButton *openButton = buttons->button(QDialogButtonBox::Open);
+    openButton->setEnabled(false);
+    connect(view->selectionModel(), &QItemSelectionModel::currentChanged, this,
+            [openButton](const QModelIndex &current) { openButton->setEnabled(current.isValid()); });
+    connect(buttons, &QDialogButtonBox::accepted, this, &QDialog::accept);
+    connect(buttons, &QDialogButtonBox::rejected, this, &QDialog::reject);
+
+    QVBoxLayout *layout = new QVBoxLayout(this);
+    layout->addWidget(infoLabel);
+    layout->addWidget(view, 1);
+    layout->addWidget(buttons);
+}
+
+quint64 HistoryGallery::selectedId() const
+{
+    const QModelIndex current = view->currentIndex();
+    return current.isValid() ? current.data(kIdRole).toULongLong() : 0;
+}
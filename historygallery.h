@@ -0,0 +1,28 @@
+#ifndef HISTORYGALLERY_H
+#define HISTORYGALLERY_H
+
+#include <QDialog>
+
+class HistoryStore;
+class QListView;
+
+// Grid of every capture in the history, newest first. Thumbnails come from
+// the store's mapped atlas as rows scroll into view; nothing is decoded
+// until a capture is chosen. Near-duplicates of the previous capture are
+// marked, so repeated captures of one screen are easy to spot.
+class HistoryGallery : public QDialog
+{
+    Q_OBJECT
+
+public:
+    explicit HistoryGallery(const HistoryStore *store, QWidget *parent = nullptr);
+
+    // Id of the chosen capture, 0 when none
+    quint64 selectedId() const;
+
+private:
+    const HistoryStore *store;
+    QListView *view;
+};
+
+#endif // HISTORYGALLERY_H
@@ -0,0 +1,436 @@
+#include "historystore.h"
+#include "profiler.h"
+#include "qoicodec.h"
+#include <QDir>
+#include <QFutureWatcher>
+#include <QSaveFile>
+#include <QStandardPaths>
+#include <QtConcurrent>
+#include <QtEndian>
+
+namespace {
+
+const char kIndexName[] = "index.bin";
+const char kAtlasName[] = "thumbs.atlas";
+const char kLockName[] = "lock";
+const char kMagic[4] = { 'S', 'H', 'I', 'S' };
+const quint32 kVersion = 2;
+const int kHeaderSize = 16;
+const int kRecordSize = 48;
+const int kSlotBytes = HistoryStore::ThumbnailWidth * HistoryStore::ThumbnailHeight * 4;
+// The atlas grows by this many slots (2.5 MB) at a time
+const int kGrowSlots = 64;
+
+QByteArray encodeHeader()
+{
+    uchar header[kHeaderSize] = {};
+    memcpy(header, kMagic, 4);
+    qToLittleEndian<quint32>(kVersion, header + 4);
+    qToLittleEndian<quint16>(HistoryStore::ThumbnailWidth, header + 8);
+    qToLittleEndian<quint16>(HistoryStore::ThumbnailHeight, header + 10);
+    return QByteArray(reinterpret_cast<const char *>(header), kHeaderSize);
+}
+
+QByteArray encodeRecord(const HistoryStore::Entry &entry)
+{
+    uchar record[kRecordSize] = {};
+    qToLittleEndian<quint64>(entry.id, record);
+    qToLittleEndian<qint64>(entry.time.toMSecsSinceEpoch(), record + 8);
+    qToLittleEndian<qint64>(entry.bytes, record + 16);
+    qToLittleEndian<quint32>(quint32(entry.size.width()), record + 24);
+    qToLittleEndian<quint32>(quint32(entry.size.height()), record + 28);
+    qToLittleEndian<quint32>(quint32(entry.slot), record + 32);
+    qToLittleEndian<quint16>(quint16(entry.thumbnailSize.width()), record + 36);
+    qToLittleEndian<quint16>(quint16(entry.thumbnailSize.height()), record + 38);
+    qToLittleEndian<quint64>(entry.hash, record + 40);
+    return QByteArray(reinterpret_cast<const char *>(record), kRecordSize);
+}
+
+HistoryStore::Entry decodeRecord(const uchar *record)
+{
+    HistoryStore::Entry entry;
+    entry.id = qFromLittleEndian<quint64>(record);
+    entry.time = QDateTime::fromMSecsSinceEpoch(qFromLittleEndian<qint64>(record + 8));
+    entry.bytes = qFromLittleEndian<qint64>(record + 16);
+    entry.size = QSize(int(qFromLittleEndian<quint32>(record + 24)),
+                       int(qFromLittleEndian<quint32>(record + 28)));
+    entry.slot = int(qFromLittleEndian<quint32>(record + 32));
+    entry.thumbnailSize = QSize(qFromLittleEndian<quint16>(record + 36),
+                                qFromLittleEndian<quint16>(record + 38));
+    entry.hash = qFromLittleEndian<quint64>(record + 40);
+    entry.pending = false;
+    return entry;
+}
+
+// Fits 'image' into a slot without enlarging it
+QImage slotThumbnail(const QImage &image)
+{
+    const QSize box(HistoryStore::ThumbnailWidth, HistoryStore::ThumbnailHeight);
+    QSize size = image.size();
+    if (size.width() > box.width() || size.height() > box.height())
+        size = size.scaled(box, Qt::KeepAspectRatio).expandedTo(QSize(1, 1));
+    const QImage scaled = size == image.size()
+        ? image
+        : image.scaled(size, Qt::IgnoreAspectRatio, Qt::SmoothTransformation);
+    return scaled.convertToFormat(QImage::Format_RGB32);
+}
+
+} // namespace
+
+HistoryStore::HistoryStore(const QString &directory, QObject *parent)
+    : QObject(parent),
+      dir(directory),
+      lock(QDir(directory).filePath(kLockName)),
+      open(false),
+      maxCount(DefaultMaxCount),
+      maxBytes(DefaultMaxBytes),
+      nextId(1),
+      atlas(nullptr),
+      atlasSlots(0)
+{
+    // One writer: records reach the index in capture order, and a capture
+    // never takes more than one core
+    pool.setMaxThreadCount(1);
+
+    PROFILE_SCOPE("history.open");
+    if (!QDir().mkpath(dir)) {
+        error = QString("Cannot create %1").arg(dir);
+        return;
+    }
+    // Held for the whole session, so never stale by age; a lock left by a
+    // crashed process is still taken over (QLockFile checks its pid)
+    lock.setStaleLockTime(0);
+    if (!lock.tryLock(0)) {
+        error = lock.error() == QLockFile::LockFailedError
+            ? QString("%1 is in use by another instance").arg(dir)
+            : QString("Cannot lock %1").arg(dir);
+        return;
+    }
+    open = openIndex() && openAtlas();
+    for (const Entry &entry : entries)
+        duplicates.insert(entry.id, entry.hash, entry.size);
+}
+
+HistoryStore::~HistoryStore()
+{
+    // Never drop a capture on exit
+    waitForWrites();
+    if (atlas)
+        atlasFile.unmap(atlas);
+}
+
+QString HistoryStore::defaultDirectory()
+{
+    const QString custom = qEnvironmentVariable("SCREENSHOTTOOL_HISTORY_DIR");
+    if (!custom.isEmpty())
+        return custom;
+    return QStandardPaths::writableLocation(QStandardPaths::AppDataLocation) + "/history";
+}
+
+void HistoryStore::setLimits(int count, qint64 bytes)
+{
+    maxCount = qMax(1, count);
+    maxBytes = qMax<qint64>(1, bytes);
+    enforceLimits();
+}
+
+int HistoryStore::indexOf(quint64 id) const
+{
+    // Newest first: lookups are mostly for recent captures
+    for (int i = entries.size() - 1; i >= 0; --i) {
+        if (entries.at(i).id == id)
+            return i;
+    }
+    return -1;
+}
+
+qint64 HistoryStore::totalBytes() const
+{
+    qint64 total = 0;
+    for (const Entry &entry : entries)
+        total += entry.bytes;
+    return total;
+}
+
+bool HistoryStore::openIndex()
+{
+    QFile index(QDir(dir).filePath(kIndexName));
+    if (!index.exists())
+        return resetFiles();
+    if (!index.open(QIODevice::ReadOnly)) {
+        error = index.errorString();
+        return false;
+    }
+
+    // A few tens of kilobytes even for thousands of captures
+    const QByteArray bytes = index.readAll();
+    index.close();
+    const uchar *data = reinterpret_cast<const uchar *>(bytes.constData());
+    if (bytes.size() < kHeaderSize || memcmp(data, kMagic, 4) != 0
+            || qFromLittleEndian<quint16>(data + 8) != ThumbnailWidth
+            || qFromLittleEndian<quint16>(data + 10) != ThumbnailHeight)
+        return resetFiles();    // not an index, or another thumbnail size
+    if (qFromLittleEndian<quint32>(data + 4) != kVersion)
+        return resetFiles();    // records of another layout
+
+    const int records = (bytes.size() - kHeaderSize) / kRecordSize;
+    entries.reserve(records);
+    for (int i = 0; i < records; ++i) {
+        const Entry entry = decodeRecord(data + kHeaderSize + i * kRecordSize);
+        entries.append(entry);
+        nextId = qMax(nextId, entry.id + 1);
+    }
+
+    // A record cut short by a crash would misalign every later append
+    if ((bytes.size() - kHeaderSize) % kRecordSize != 0)
+        return rewriteIndex();
+    return true;
+}
+
+bool HistoryStore::openAtlas()
+{
+    atlasFile.setFileName(QDir(dir).filePath(kAtlasName));
+    if (!atlasFile.open(QIODevice::ReadWrite)) {
+        error = atlasFile.errorString();
+        return false;
+    }
+
+    int slots = int(atlasFile.size() / kSlotBytes);
+    QVector<bool> used(slots);
+    for (const Entry &entry : entries) {
+        if (entry.slot >= used.size()) {
+            slots = entry.slot + 1;
+            used.resize(slots);
+        }
+        used[entry.slot] = true;
+    }
+    // Lowest slots are taken first
+    freeSlots.clear();
+    for (int slot = slots - 1; slot >= 0; --slot) {
+        if (!used.at(slot))
+            freeSlots.append(slot);
+    }
+    return slots == 0 || mapAtlas(slots);
+}
+
+bool HistoryStore::resetFiles()
+{
+    if (atlas) {
+        atlasFile.unmap(atlas);
+        atlas = nullptr;
+    }
+    atlasFile.close();
+    atlasSlots = 0;
+
+    QDir directory(dir);
+    for (const QString &name : directory.entryList(QStringList() << "*.qoi", QDir::Files))
+        directory.remove(name);
+    directory.remove(kAtlasName);
+    entries.clear();
+    freeSlots.clear();
+    duplicates.clear();
+    return rewriteIndex();
+}
+
+bool HistoryStore::mapAtlas(int slots)
+{
+    if (atlas) {
+        atlasFile.unmap(atlas);
+        atlas = nullptr;
+        atlasSlots = 0;
+    }
+    const qint64 size = qint64(slots) * kSlotBytes;
+    if ((atlasFile.size() < size && !atlasFile.resize(size))
+            || !(atlas = atlasFile.map(0, size))) {
+        error = atlasFile.errorString();
+        return false;
+    }
+    atlasSlots = slots;
+    return true;
+}
+
+int HistoryStore::takeSlot()
+{
+    if (freeSlots.isEmpty()) {
+        const int first = atlasSlots;
+        if (!mapAtlas(first + kGrowSlots))
+            return -1;
+        for (int slot = first + kGrowSlots - 1; slot > first; --slot)
+            freeSlots.append(slot);
+        return first;
+    }
+    return freeSlots.takeLast();
+}
+
+QString HistoryStore::imagePath(quint64 id) const
+{
+    return QDir(dir).filePath(QString::number(id) + ".qoi");
+}
+
+quint64 HistoryStore::append(const QImage &image, quint64 hash, const QImage &thumbnail)
+{
+    PROFILE_SCOPE("history.append");
+    if (!open || image.isNull())
+        return 0;
+    const int slot = takeSlot();
+    if (slot < 0)
+        return 0;
+
+    const QImage small = slotThumbnail(thumbnail.isNull() ? image : thumbnail);
+    uchar *target = atlas + qptrdiff(slot) * kSlotBytes;
+    for (int y = 0; y < small.height(); ++y)
+        memcpy(target + y * ThumbnailWidth * 4, small.constScanLine(y), size_t(small.width()) * 4);
+
+    Entry entry;
+    entry.id = nextId++;
+    entry.time = QDateTime::currentDateTime();
+    entry.size = image.size();
+    entry.thumbnailSize = small.size();
+    entry.bytes = 0;
+    entry.slot = slot;
+    entry.hash = hash;
+    entry.pending = true;
+    entries.append(entry);
+    duplicates.insert(entry.id, hash, entry.size);
+    pendingImages.insert(entry.id, image);
+
+    // QSaveFile: a capture cut short by a crash leaves no .qoi behind
+    const quint64 id = entry.id;
+    const QString path = imagePath(id);
+    QFuture<WriteResult> future = QtConcurrent::run(&pool, [id, path, image]() -> WriteResult {
+        PROFILE_SCOPE("history.write");
+        WriteResult result = { id, 0, false };
+        QSaveFile file(path);
+        if (file.open(QIODevice::WriteOnly) && QoiCodec::write(image, &file)) {
+            result.bytes = file.pos();
+            result.ok = file.commit();
+        }
+        return result;
+    });
+    writes.insert(id, future);
+
+    QFutureWatcher<WriteResult> *watcher = new QFutureWatcher<WriteResult>(this);
+    connect(watcher, &QFutureWatcher<WriteResult>::finished, this, [this, watcher]() {
+        const WriteResult result = watcher->result();
+        watcher->deleteLater();
+        onWritten(result);
+    });
+    watcher->setFuture(future);
+    return id;
+}
+
+// On the GUI thread; waitForWrites() may have handled the result already
+void HistoryStore::onWritten(const WriteResult &result)
+{
+    if (!writes.remove(result.id))
+        return;
+    pendingImages.remove(result.id);
+    const int index = indexOf(result.id);
+    if (index < 0)
+        return;
+
+    if (!result.ok) {
+        freeSlots.append(entries.at(index).slot);
+        duplicates.remove(result.id);
+        entries.remove(index);
+        return;
+    }
+    Entry &entry = entries[index];
+    entry.bytes = result.bytes;
+    entry.pending = false;
+    appendRecord(entry);
+    enforceLimits();
+}
+
+void HistoryStore::waitForWrites()
+{
+    pool.waitForDone();
+    const QList<QFuture<WriteResult> > finished = writes.values();
+    for (const QFuture<WriteResult> &future : finished)
+        onWritten(future.result());
+}
+
+bool HistoryStore::appendRecord(const Entry &entry)
+{
+    QFile index(QDir(dir).filePath(kIndexName));
+    const QByteArray record = encodeRecord(entry);
+    if (!index.open(QIODevice::WriteOnly | QIODevice::Append) || index.write(record) != record.size()) {
+        error = index.errorString();
+        return false;
+    }
+    return true;
+}
+
+bool HistoryStore::rewriteIndex()
+{
+    QSaveFile index(QDir(dir).filePath(kIndexName));
+    if (!index.open(QIODevice::WriteOnly)) {
+        error = index.errorString();
+        return false;
+    }
+    QByteArray bytes = encodeHeader();
+    bytes.reserve(kHeaderSize + entries.size() * kRecordSize);
+    for (const Entry &entry : entries) {
+        if (!entry.pending)
+            bytes += encodeRecord(entry);
+    }
+    if (index.write(bytes) != bytes.size() || !index.commit()) {
+        error = index.errorString();
+        return false;
+    }
+    return true;
+}
+
+// Evicts the oldest written captures; pending ones are the newest anyway
+void HistoryStore::enforceLimits()
+{
+    qint64 bytes = totalBytes();
+    bool evicted = false;
+    while (!entries.isEmpty() && !entries.first().pending
+           && (entries.size() > maxCount || bytes > maxBytes)) {
+        const Entry oldest = entries.takeFirst();
+        QFile::remove(imagePath(oldest.id));
+        freeSlots.append(oldest.slot);
+        duplicates.remove(oldest.id);
+        bytes -= oldest.bytes;
+        evicted = true;
+    }
+    if (evicted)
+        rewriteIndex();
+}
+
+QImage HistoryStore::thumbnail(int index) const
+{
+    const Entry &entry = entries.at(index);
+    if (!atlas || entry.slot >= atlasSlots)
+        return QImage();
+    const uchar *bits = atlas + qptrdiff(entry.slot) * kSlotBytes;
+    return QImage(bits,
+                  entry.thumbnailSize.width(), entry.thumbnailSize.height(),
+                  ThumbnailWidth * 4, QImage::Format_RGB32);
+}
+
+QImage HistoryStore::load(quint64 id, QString *errorMessage) const
+{
+    PROFILE_SCOPE("history.load");
+    auto pendingImage = pendingImages.constFind(id);
+    if (pendingImage != pendingImages.constEnd())
+        return pendingImage.value();
+
+    QFile file(imagePath(id));
+    if (!file.open(QIODevice::ReadOnly)) {
+        if (errorMessage)
+            *errorMessage = file.errorString();
+        return QImage();
+    }
+    return QoiCodec::read(&file, errorMessage);
+}
+
+void HistoryStore::clear()
+{
+    // The files belong to the instance holding the lock
+    if (!lock.isLocked())
+        return;
+    waitForWrites();
+    open = resetFiles() && openAtlas();
+}
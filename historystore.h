@@ -0,0 +1,144 @@
+#ifndef HISTORYSTORE_H
+#define HISTORYSTORE_H
+
+#include <QDateTime>
+#include <QFile>
+#include <QFuture>
+#include <QHash>
+#include <QImage>
+#include <QLockFile>
+#include <QObject>
+#include <QSize>
+#include <QThreadPool>
+#include <QVector>
+#include "perceptualhash.h"
+
+// Every capture of every session, on disk.
+//
+// The directory holds three kinds of files:
+//  - index.bin: a short header and one fixed 48-byte record per capture
+//    (id, time, size, bytes on disk, thumbnail slot, perceptual hash),
+//    appended as captures are written and rewritten only when old captures
+//    are evicted;
+//  - thumbs.atlas: fixed-size RGB32 thumbnail slots, memory-mapped. A
+//    thumbnail is a QImage over the mapping, so a gallery of thousands of
+//    captures opens by reading the index and scrolls by touching pages;
+//  - <id>.qoi: the full-resolution image, decoded only by load().
+//
+// append() stores the thumbnail right away and writes the image on a
+// worker thread; until then load() returns the image from memory. The
+// oldest written captures are evicted when either limit is exceeded.
+//
+// The perceptual hashes of all captures are kept in a DuplicateIndex, so
+// findDuplicate() recognizes an unchanged screen across sessions too.
+//
+// One process at a time owns a directory, through a lock file in it: a
+// second instance would hand out the same ids and thumbnail slots, so it
+// gets a store that is not open.
+class HistoryStore : public QObject
+{
+    Q_OBJECT
+
+public:
+    static const int ThumbnailWidth = 128;
+    static const int ThumbnailHeight = 80;
+    static const int DefaultMaxCount = 1000;
+    static const qint64 DefaultMaxBytes = qint64(2) * 1024 * 1024 * 1024;
+
+    struct Entry {
+        quint64 id;
+        QDateTime time;
+        QSize size;             // full image
+        QSize thumbnailSize;    // within ThumbnailWidth x ThumbnailHeight
+        qint64 bytes;           // size of the .qoi file, 0 while pending
+        int slot;               // thumbnail slot in the atlas
+        quint64 hash;           // PerceptualHash::compute of the image
+        bool pending;           // still being written
+    };
+
+    // Opens (or creates) the store in 'directory'; not open when another
+    // process holds it
+    explicit HistoryStore(const QString &directory, QObject *parent = nullptr);
+    ~HistoryStore() override;
+
+    // SCREENSHOTTOOL_HISTORY_DIR, else "history" in the application data folder
+    static QString defaultDirectory();
+
+    bool isOpen() const { return open; }
+    QString errorString() const { return error; }
+    QString directory() const { return dir; }
+
+    void setLimits(int maxCount, qint64 maxBytes);
+
+    // Oldest first
+    int count() const { return entries.size(); }
+    const Entry &entry(int index) const { return entries.at(index); }
+    int indexOf(quint64 id) const;
+    qint64 totalBytes() const;
+
+    // Adds a capture with its perceptual hash; 'thumbnail' may be any
+    // downscaled copy (e.g. from the preview pyramid), it is scaled again to
+    // fit a slot. Returns the id, 0 when the store is not open.
+    quint64 append(const QImage &image, quint64 hash, const QImage &thumbnail = QImage());
+
+    // Closest capture of the same size, pending ones included, whose hash
+    // is within 'maxDistance' bits of 'hash'
+    DuplicateIndex::Match findDuplicate(quint64 hash, const QSize &size,
+                                        int maxDistance = PerceptualHash::NearDuplicateDistance) const
+    {
+        return duplicates.nearest(hash, size, maxDistance);
+    }
+
+    // Over the mapped atlas: no copy, no decoding. Valid until the next
+    // append() or clear(), which may remap the atlas.
+    QImage thumbnail(int index) const;
+
+    // Full-resolution image; decodes the .qoi file
+    QImage load(quint64 id, QString *errorMessage = nullptr) const;
+
+    // Removes every capture and its files
+    void clear();
+
+    // Blocks until every pending image is on disk
+    void waitForWrites();
+
+private:
+    struct WriteResult {
+        quint64 id;
+        qint64 bytes;
+        bool ok;
+    };
+
+    bool openIndex();
+    bool openAtlas();
+    bool resetFiles();
+    bool mapAtlas(int slots);
+    int takeSlot();
+    void onWritten(const WriteResult &result);
+    bool appendRecord(const Entry &entry);
+    bool rewriteIndex();
+    void enforceLimits();
+    QString imagePath(quint64 id) const;
+
+    QString dir;
+    QLockFile lock;
+    QString error;
+    bool open;
+    int maxCount;
+    qint64 maxBytes;
+    quint64 nextId;
+
+    QVector<Entry> entries;
+    QVector<int> freeSlots;
+    QHash<quint64, QImage> pendingImages;
+    QHash<quint64, QFuture<WriteResult> > writes;
+    DuplicateIndex duplicates;
+
+    QFile atlasFile;
+    uchar *atlas;
+    int atlasSlots;
+
+    QThreadPool pool;
+};
+
+#endif // HISTORYSTORE_H
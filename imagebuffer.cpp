@@ -0,0 +1,68 @@
+#include "imagebuffer.h"
+
+namespace {
+
+// Keeps the parent alive for as long as a view QImage references it
+void releaseParent(void *parent)
+{
+    delete static_cast<QImage *>(parent);
+}
+
+} // namespace
+
+ImageBuffer::ImageBuffer()
+{
+}
+
+ImageBuffer::ImageBuffer(const QImage &image)
+    : pixels(image),
+      roi(image.rect())
+{
+}
+
+ImageBuffer ImageBuffer::fromPixmap(const QPixmap &pixmap)
+{
+    // On raster platforms toImage() shares the pixmap's backing image
+    return ImageBuffer(pixmap.toImage());
+}
+
+ImageBuffer ImageBuffer::region(const QRect &area) const
+{
+    ImageBuffer view(*this);
+    view.roi = area.translated(roi.topLeft()).intersected(roi);
+    return view;
+}
+
+QImage ImageBuffer::image() const
+{
+    if (pixels.isNull() || roi.isEmpty())
+        return QImage();
+    if (!isView())
+        return pixels;
+
+    // Sub-byte and indexed formats cannot be addressed by a plain pointer
+    if (pixels.depth() % 8 != 0 || pixels.colorCount() > 0)
+        return pixels.copy(roi);
+
+    const uchar *bits = pixels.constBits()
+        + qptrdiff(roi.y()) * pixels.bytesPerLine()
+        + qptrdiff(roi.x()) * (pixels.depth() / 8);
+    QImage view(bits, roi.width(), roi.height(), pixels.bytesPerLine(), pixels.format(),
+                releaseParent, new QImage(pixels));
+    view.setDevicePixelRatio(pixels.devicePixelRatio());
+    return view;
+}
+
+QImage &ImageBuffer::edit()
+{
+    if (isView()) {
+        pixels = image().copy();
+        roi = pixels.rect();
+    }
+    return pixels;
+}
+
+bool ImageBuffer::sharesPixelsWith(const ImageBuffer &other) const
+{
+    return !pixels.isNull() && pixels.constBits() == other.pixels.constBits();
+}
@@ -0,0 +1,50 @@
+#ifndef IMAGEBUFFER_H
+#define IMAGEBUFFER_H
+
+#include <QImage>
+#include <QPixmap>
+#include <QRect>
+
+// CPU-side capture buffer shared by the capture code, RegionSelector,
+// ScreenshotTool and ImageEditor.
+//
+// Copies are implicitly shared (QImage semantics) and region() returns a
+// view that references the parent pixels, so cropping or selecting a region
+// is O(1). Pixels are copied only when a view is written to through edit().
+class ImageBuffer
+{
+public:
+    ImageBuffer();
+    explicit ImageBuffer(const QImage &image);
+    static ImageBuffer fromPixmap(const QPixmap &pixmap);
+
+    bool isNull() const { return pixels.isNull(); }
+    int width() const { return roi.width(); }
+    int height() const { return roi.height(); }
+    QSize size() const { return roi.size(); }
+    QRect rect() const { return QRect(QPoint(0, 0), roi.size()); }
+
+    // True when this buffer is a view into a larger parent buffer
+    bool isView() const { return roi != pixels.rect(); }
+
+    // View of 'area' (in this buffer's coordinates, clipped to it)
+    ImageBuffer region(const QRect &area) const;
+
+    // Read-only image over this buffer's pixels, without copying them.
+    // Writing to the returned QImage detaches it, never the parent.
+    QImage image() const;
+
+    // Pixels for modification. A view is copied out of its parent on the
+    // first call; after that edits happen in place unless shared again.
+    QImage &edit();
+
+    QPixmap toPixmap() const { return QPixmap::fromImage(image()); }
+
+    bool sharesPixelsWith(const ImageBuffer &other) const;
+
+private:
+    QImage pixels;  // parent buffer
+    QRect roi;      // this view inside 'pixels'
+};
+
+#endif // IMAGEBUFFER_H
@@ -1,12 +1,15 @@
 #include "imageeditor.h"
+#include "profiler.h"
 #include <QVBoxLayout>
 #include <QHBoxLayout>
 #include <QPushButton>
 #include <QToolButton>
 #include <QColorDialog>
 #include <QSpinBox>
+#include <QComboBox>
 #include <QLabel>
 #include <QMouseEvent>
+#include <QPaintEvent>
 #include <QPainter>
 #include <QGraphicsScene>
 #include <QGraphicsView>
@@ -19,15 +22,25 @@
 #include <QStyleOption>
 #include <QStyle>
 #include <QApplication>
-#include <cmath>
+#include <QProgressBar>
+#include <QShortcut>
+#include <QtConcurrent>
+
+namespace {
+// Regions at least this large are blurred on the thread pool
+const qint64 kParallelBlurPixels = 1024 * 1024;
+}
 
 ImageEditor::ImageEditor(QWidget *parent)
     : QWidget(parent)
     , currentTool(EditTool::Select)
     , isDrawing(false)
+    , draggedAnnotation(-1)
     , currentColor(Qt::red)
     , currentThickness(3)
     , currentBlurRadius(10)
+    , currentBlurQuality(BlurEngine::Quality::Gaussian)
+    , blurPreviewScale(1)
     , handleSize(10)
     , isDraggingHandle(false)
     , dragHandleIndex(-1)
@@ -39,20 +52,49 @@ ImageEditor::ImageEditor(QWidget *parent)
 
 ImageEditor::~ImageEditor()
 {
-    // Clean up resources if needed
+    // The blur task only holds copies, but its result must not outlive us
+    blurWatcher->waitForFinished();
 }
 
-void ImageEditor::setImage(const QPixmap &image)
+void ImageEditor::setImage(const ImageBuffer &image)
 {
-    originalImage = image;
+    // Re-opening the editor on its own flattened result continues with the
+    // base image and the still editable annotations
+    if (!annotations.isEmpty() && image.sharesPixelsWith(exportedImage)
+            && image.size() == exportedImage.size()) {
+        update();
+        return;
+    }
+    
+    // A blur still running belongs to the previous image: its section and
+    // rectangle mean nothing in the new one, so the result is dropped
+    if (blurWatcher->isRunning()) {
+        blurWatcher->waitForFinished();
+        pendingBlurRect = QRect();
+    }
+    
+    // Re-opening the editor on its own result keeps the undo history
+    if (!image.sharesPixelsWith(currentImage) || image.size() != currentImage.size()) {
+        history.clear();
+        annotations.clear();
+        updateUndoButtons();
+    }
+    
+    // Shares the caller's pixels; they are copied on the first edit only
     currentImage = image;
-    previewImage = image;
+    invalidateBlurPreview();
     update();
 }
 
-QPixmap ImageEditor::getImage() const
+ImageBuffer ImageEditor::getImage() const
 {
-    return currentImage;
+    return annotations.flatten(currentImage);
+}
+
+ImageBuffer ImageEditor::exportImage()
+{
+    exportedImage = getImage();
+    return exportedImage;
 }
 
 void ImageEditor::setupUI()
@@ -64,6 +106,12 @@ void ImageEditor::setupUI()
     QHBoxLayout *toolbarLayout = new QHBoxLayout(toolbar);
     
     // Tool buttons
+    QToolButton *selectButton = new QToolButton(this);
+    selectButton->setText("Select");
+    selectButton->setCheckable(true);
+    selectButton->setChecked(true);
+    connect(selectButton, &QToolButton::clicked, [this]() { onToolSelected(EditTool::Select); });
+    
     QToolButton *cropButton = new QToolButton(this);
     cropButton->setText("Crop");
     cropButton->setCheckable(true);
@@ -84,6 +132,27 @@ void ImageEditor::setupUI()
     textButton->setCheckable(true);
     connect(textButton, &QToolButton::clicked, [this]() { onToolSelected(EditTool::Text); });
     
+    // Undo / redo
+    undoButton = new QPushButton("Undo", this);
+    undoButton->setToolTip("Ctrl+Z");
+    connect(undoButton, &QPushButton::clicked, this, &ImageEditor::onUndo);
+    
+    redoButton = new QPushButton("Redo", this);
+    redoButton->setToolTip("Ctrl+Y");
+    connect(redoButton, &QPushButton::clicked, this, &ImageEditor::onRedo);
+    
+    QShortcut *undoShortcut = new QShortcut(QKeySequence::Undo, this);
+    undoShortcut->setContext(Qt::WidgetWithChildrenShortcut);
+    connect(undoShortcut, &QShortcut::activated, this, &ImageEditor::onUndo);
+    
+    QShortcut *redoShortcut = new QShortcut(QKeySequence::Redo, this);
+    redoShortcut->setContext(Qt::WidgetWithChildrenShortcut);
+    connect(redoShortcut, &QShortcut::activated, this, &ImageEditor::onRedo);
+    
+    // Finish editing and hand the flattened image back
+    QPushButton *doneButton = new QPushButton("Done", this);
+    connect(doneButton, &QPushButton::clicked, this, &ImageEditor::onDone);
+    
     // Color button
     QPushButton *colorButton = new QPushButton("Color", this);
     connect(colorButton, &QPushButton::clicked, this, &ImageEditor::onColorChanged);
@@ -104,6 +173,23 @@ void ImageEditor::setupUI()
     connect(blurSpinBox, QOverload<int>::of(&QSpinBox::valueChanged), 
             this, &ImageEditor::onBlurRadiusChanged);
     
+    // Blur quality control
+    QComboBox *blurQualityComboBox = new QComboBox(this);
+    blurQualityComboBox->addItem("Box");
+    blurQualityComboBox->addItem("Gaussian");
+    blurQualityComboBox->setCurrentIndex(1);
+    connect(blurQualityComboBox, QOverload<int>::of(&QComboBox::currentIndexChanged),
+            this, &ImageEditor::onBlurQualityChanged);
+    
+    // Progress of background blur operations
+    blurProgressBar = new QProgressBar(this);
+    blurProgressBar->setMaximumWidth(150);
+    blurProgressBar->setTextVisible(false);
+    blurProgressBar->hide();
+    
+    blurWatcher = new QFutureWatcher<QImage>(this);
+    connect(blurWatcher, &QFutureWatcher<QImage>::finished, this, &ImageEditor::onBlurFinished);
+    
     // Text input
     textLineEdit = new QLineEdit(this);
     textLineEdit->setPlaceholderText("Enter text...");
@@ -111,17 +197,24 @@ void ImageEditor::setupUI()
     connect(textLineEdit, &QLineEdit::editingFinished, this, &ImageEditor::onTextEditingFinished);
     
     // Add widgets to toolbar
+    toolbarLayout->addWidget(selectButton);
     toolbarLayout->addWidget(cropButton);
     toolbarLayout->addWidget(blurButton);
     toolbarLayout->addWidget(arrowButton);
     toolbarLayout->addWidget(textButton);
+    toolbarLayout->addWidget(undoButton);
+    toolbarLayout->addWidget(redoButton);
+    toolbarLayout->addWidget(doneButton);
     toolbarLayout->addWidget(colorButton);
     toolbarLayout->addWidget(thicknessLabel);
     toolbarLayout->addWidget(thicknessSpinBox);
     toolbarLayout->addWidget(blurLabel);
     toolbarLayout->addWidget(blurSpinBox);
+    toolbarLayout->addWidget(blurQualityComboBox);
     toolbarLayout->addWidget(textLineEdit);
     toolbarLayout->addStretch();
+    toolbarLayout->addWidget(blurProgressBar);
+    updateUndoButtons();
     
     mainLayout->addWidget(toolbar);
     
@@ -145,34 +238,49 @@ void ImageEditor::setupConnections()
 
 void ImageEditor::paintEvent(QPaintEvent *event)
 {
-    Q_UNUSED(event)
-    
+    PROFILE_SCOPE("imageEditor.paint");
     QPainter painter(this);
     
     // Draw the current image
     if (!currentImage.isNull()) {
         // Calculate position to center the image
-        int x = (width() - currentImage.width()) / 2;
-        int y = (height() - currentImage.height()) / 2;
+        const QPoint offset = imageOffset();
+        
+        // Blit only the exposed parts of the image
+        const QImage pixels = currentImage.image();
+        for (const QRect &exposed : event->region()) {
+            const QRect source = exposed.translated(-offset).intersected(pixels.rect());
+            if (!source.isEmpty())
+                painter.drawImage(source.translated(offset), pixels, source);
+        }
         
-        painter.drawPixmap(x, y, currentImage);
+        // The blur preview lies under the annotations, like the real blur
+        if (currentTool == EditTool::Blur && isDrawing) {
+            drawBlurOverlay(painter);
+        }
+        
+        // Annotations are drawn over the image, never into it
+        painter.translate(offset);
+        annotations.paint(painter, event->rect().translated(-offset));
+        painter.translate(-offset);
         
         // Draw editing overlays based on current tool
         if (currentTool == EditTool::Crop && isDrawing) {
             drawCropHandles(painter);
-        } else if (currentTool == EditTool::Blur && isDrawing) {
-            drawBlurOverlay(painter);
         } else if (currentTool == EditTool::Arrow && isDrawing) {
             drawArrow(painter);
         } else if (currentTool == EditTool::Text && isDrawing) {
             drawText(painter);
         }
     }
+    
+    painter.end();
+    Profiler::recordPixels("imageEditor.paint", event->region());
 }
 
 void ImageEditor::mousePressEvent(QMouseEvent *event)
 {
-    if (event->button() != Qt::LeftButton) {
+    if (event->button() != Qt::LeftButton || blurWatcher->isRunning()) {
         return;
     }
     
@@ -180,6 +288,12 @@ void ImageEditor::mousePressEvent(QMouseEvent *event)
     endPoint = event->pos();
     isDrawing = true;
     
+    // Pick up an annotation to move it
+    if (currentTool == EditTool::Select) {
+        draggedAnnotation = annotations.hitTest(startPoint - imageOffset());
+        annotationsBeforeDrag = annotations;
+    }
+    
     // Check if clicking on a crop handle
     if (currentTool == EditTool::Crop) {
         // Calculate handle positions based on current activeCropRect
@@ -211,6 +325,9 @@ void ImageEditor::mousePressEvent(QMouseEvent *event)
             isDraggingHandle = false;
             activeCropRect = QRect(startPoint, QSize());
         }
+    } else if (currentTool == EditTool::Blur) {
+        ensureBlurPreview();
+        activeCropRect = QRect(startPoint, QSize());
     }
     
     update();
@@ -222,8 +339,20 @@ void ImageEditor::mouseMoveEvent(QMouseEvent *event)
         return;
     }
     
+    const QPoint previousPoint = endPoint;
+    const QRect cropRectBefore = activeCropRect;
     endPoint = event->pos();
     
+    if (currentTool == EditTool::Select) {
+        // Only the area the annotation leaves and enters is repainted
+        if (draggedAnnotation >= 0) {
+            const QRect before = annotations.at(draggedAnnotation).bounds;
+            annotations.moveBy(draggedAnnotation, endPoint - previousPoint);
+            update((before | annotations.at(draggedAnnotation).bounds).translated(imageOffset()));
+        }
+        return;
+    }
+    
     if (currentTool == EditTool::Crop && isDraggingHandle) {
         // Adjust crop rectangle based on which handle is being dragged
         switch (dragHandleIndex) {
@@ -260,9 +389,21 @@ void ImageEditor::mouseMoveEvent(QMouseEvent *event)
     } else if (currentTool == EditTool::Crop && !isDraggingHandle) {
         // Update the crop rectangle
         activeCropRect = getNormalizedRect(startPoint, endPoint);
+    } else if (currentTool == EditTool::Blur) {
+        activeCropRect = getNormalizedRect(startPoint, endPoint);
+        update(rectChange(cropRectBefore, activeCropRect, 3));
+        return;
+    } else if (currentTool == EditTool::Arrow) {
+        // Old and new arrow previews only
+        update(Annotation::arrowBounds(startPoint, previousPoint, currentThickness)
+               | Annotation::arrowBounds(startPoint, endPoint, currentThickness));
+        return;
+    } else {
+        return;
     }
     
-    update();
+    // Crop: the border and corner handles travel with the rectangle
+    update(rectChange(cropRectBefore, activeCropRect, handleSize / 2 + 2));
 }
 
 void ImageEditor::mouseReleaseEvent(QMouseEvent *event)
@@ -274,6 +415,16 @@ void ImageEditor::mouseReleaseEvent(QMouseEvent *event)
     isDrawing = false;
     isDraggingHandle = false;
     
+    if (currentTool == EditTool::Select) {
+        if (draggedAnnotation >= 0 && endPoint != startPoint) {
+            history.recordAnnotations(annotationsBeforeDrag);
+            updateUndoButtons();
+        }
+        draggedAnnotation = -1;
+        annotationsBeforeDrag.clear();
+        return;
+    }
+    
     if (currentTool == EditTool::Crop) {
         applyCrop();
     } else if (currentTool == EditTool::Blur) {
@@ -331,15 +482,18 @@ void ImageEditor::drawCropHandles(QPainter &painter)
 
 void ImageEditor::drawBlurOverlay(QPainter &painter)
 {
-    if (activeCropRect.isValid()) {
-        // Create a blurred version of the selected area
-        QPixmap blurredSection = currentImage.copy(activeCropRect).scaled(
-            activeCropRect.size() * 0.1, Qt::IgnoreAspectRatio, Qt::SmoothTransformation);
-        blurredSection = blurredSection.scaled(
-            activeCropRect.size(), Qt::IgnoreAspectRatio, Qt::SmoothTransformation);
-        
-        // Draw the blurred section
-        painter.drawPixmap(activeCropRect, blurredSection);
+    if (activeCropRect.isValid() && !blurPreview.isNull()) {
+        // Stretch the matching part of the cached low-resolution blur; the
+        // paint event's clip limits this to the strips that changed
+        const QPoint offset = imageOffset();
+        const QRect imageRect = activeCropRect.translated(-offset).intersected(currentImage.rect());
+        const QRectF previewRect(QPointF(imageRect.topLeft()) / blurPreviewScale,
+                                 QSizeF(imageRect.size()) / blurPreviewScale);
+        
+        painter.save();
+        painter.setRenderHint(QPainter::SmoothPixmapTransform);
+        painter.drawImage(imageRect.translated(offset), blurPreview, previewRect);
+        painter.restore();
         
         // Draw border around the blurred area
         painter.setBrush(Qt::NoBrush);
@@ -348,11 +502,25 @@ void ImageEditor::drawBlurOverlay(QPainter &painter)
     }
 }
 
+// Built once per image and blur setting; a 4K frame is reduced to 1/4 size
+// before blurring, so this takes a few milliseconds
+void ImageEditor::ensureBlurPreview()
+{
+    if (blurPreview.isNull() && !currentImage.isNull()) {
+        blurPreview = BlurEngine::blurPreview(currentImage.image(), currentBlurRadius,
+                                              currentBlurQuality, &blurPreviewScale);
+    }
+}
+
+void ImageEditor::invalidateBlurPreview()
+{
+    blurPreview = QImage();
+}
+
 void ImageEditor::drawArrow(QPainter &painter)
 {
-    Q_UNUSED(painter)
-    // Arrow will be drawn in the temporary preview
-    // Actual arrow will be applied when mouse is released
+    // Preview of the arrow being dragged; it joins the annotations on release
+    Annotation::paintArrow(painter, startPoint, endPoint, currentColor, currentThickness);
 }
 
 void ImageEditor::drawText(QPainter &painter)
@@ -366,190 +534,181 @@ void ImageEditor::drawText(QPainter &painter)
 
 void ImageEditor::applyCrop()
 {
-    if (activeCropRect.isValid() && !originalImage.isNull()) {
-        // Convert coordinates from widget space to image space
-        // Calculate the scaling factor between widget and image
-        qreal scaleX = static_cast<qreal>(originalImage.width()) / width();
-        qreal scaleY = static_cast<qreal>(originalImage.height()) / height();
-        
-        // Adjust crop rectangle to image coordinates
-        QRect imageCropRect(
-            static_cast<int>(activeCropRect.x() * scaleX),
-            static_cast<int>(activeCropRect.y() * scaleY),
-            static_cast<int>(activeCropRect.width() * scaleX),
-            static_cast<int>(activeCropRect.height() * scaleY)
-        );
+    PROFILE_SCOPE("editor.applyCrop");
+    if (activeCropRect.isValid() && !currentImage.isNull()) {
+        // The image is drawn unscaled at imageOffset(), as for the blur
+        QRect imageCropRect = activeCropRect.translated(-imageOffset());
         
         // Ensure the crop rectangle stays within image bounds
-        imageCropRect = imageCropRect.intersected(originalImage.rect());
+        imageCropRect = imageCropRect.intersected(currentImage.rect());
         
         if (imageCropRect.isValid() && !imageCropRect.isEmpty()) {
-            // Crop the image to the selected rectangle
-            QPixmap cropped = originalImage.copy(imageCropRect);
-            currentImage = cropped;
-            originalImage = cropped; // Update original for future operations
+            // Crop the image to the selected rectangle (a view, no copy);
+            // the previous image stays reachable through undo
+            history.recordReplace(currentImage, annotations);
+            currentImage = currentImage.region(imageCropRect);
+            invalidateBlurPreview();
+            annotations.translate(-imageCropRect.topLeft());
+            updateUndoButtons();
             
             // Reset crop rectangle
             activeCropRect = QRect();
             
-            emit imageEdited(currentImage);
+            emitEdited();
         }
     }
 }
 
 void ImageEditor::applyBlur()
 {
-    if (activeCropRect.isValid() && !currentImage.isNull()) {
-        // Create a copy of the current image to modify
-        QPixmap result = currentImage;
-        
-        // Convert coordinates from widget space to image space
-        qreal scaleX = static_cast<qreal>(currentImage.width()) / width();
-        qreal scaleY = static_cast<qreal>(currentImage.height()) / height();
-        
-        // Adjust blur rectangle to image coordinates
-        QRect imageBlurRect(
-            static_cast<int>(activeCropRect.x() * scaleX),
-            static_cast<int>(activeCropRect.y() * scaleY),
-            static_cast<int>(activeCropRect.width() * scaleX),
-            static_cast<int>(activeCropRect.height() * scaleY)
-        );
+    PROFILE_SCOPE("editor.applyBlur");
+    if (activeCropRect.isValid() && !currentImage.isNull() && !blurWatcher->isRunning()) {
+        // The image is drawn unscaled at imageOffset(), exactly where the
+        // preview showed the blur
+        QRect imageBlurRect = activeCropRect.translated(-imageOffset());
         
         // Ensure the blur rectangle stays within image bounds
         imageBlurRect = imageBlurRect.intersected(currentImage.rect());
         
-        if (imageBlurRect.isValid() && !imageBlurRect.isEmpty()) {
-            // Create a copy of the area to blur
-            QPixmap sourceSection = currentImage.copy(imageBlurRect);
-            
-            // Apply blur effect using QImage manipulation
-            QImage blurredImage = sourceSection.toImage();
-            blurImage(blurredImage, currentBlurRadius);
-            
-            // Draw the blurred section back onto the result image
-            QPainter painter(&result);
-            painter.drawImage(imageBlurRect, blurredImage);
-            
-            currentImage = result;
-        }
-        
         // Reset blur rectangle
         activeCropRect = QRect();
         
-        emit imageEdited(currentImage);
+        if (!imageBlurRect.isValid() || imageBlurRect.isEmpty()) {
+            emitEdited();
+            return;
+        }
+        
+        // Read-only view; blurring it copies just this section
+        QImage section = currentImage.region(imageBlurRect).image();
+        
+        if (qint64(imageBlurRect.width()) * imageBlurRect.height() < kParallelBlurPixels) {
+            blurImage(section, currentBlurRadius);
+            pendingBlurRect = imageBlurRect;
+            finishBlur(section);
+            return;
+        }
+        
+        // Large regions are blurred in row bands on all cores while the
+        // editor keeps processing events and shows progress
+        const int radius = currentBlurRadius;
+        const BlurEngine::Quality quality = currentBlurQuality;
+        pendingBlurRect = imageBlurRect;
+        blurProgressBar->setValue(0);
+        blurProgressBar->show();
+        setCursor(Qt::BusyCursor);
+        blurWatcher->setFuture(QtConcurrent::run([this, section, radius, quality]() {
+            PROFILE_SCOPE("editor.blurParallel");
+            QImage blurred = section;
+            BlurEngine::blurParallel(blurred, radius, quality, 0, [this](int done, int total) {
+                QMetaObject::invokeMethod(this, "onBlurProgress", Qt::QueuedConnection,
+                                          Q_ARG(int, done), Q_ARG(int, total));
+            });
+            return blurred;
+        }));
     }
 }
 
-// Helper function to apply Gaussian blur to an image
-void ImageEditor::blurImage(QImage &image, int radius)
+void ImageEditor::onBlurProgress(int done, int total)
 {
-    if (radius <= 0) return;
-    
-    // A simple box blur implementation - for a more sophisticated Gaussian blur,
-    // we could implement a more complex algorithm
-    QImage blurred = image;
+    blurProgressBar->setRange(0, total);
+    blurProgressBar->setValue(done);
+}
+
+void ImageEditor::onBlurFinished()
+{
+    blurProgressBar->hide();
+    unsetCursor();
+    // Dropped by setImage()
+    if (pendingBlurRect.isNull())
+        return;
+    finishBlur(blurWatcher->result());
+}
+
+void ImageEditor::finishBlur(const QImage &blurred)
+{
+    // Draw the blurred section back in place
+    QImage &pixels = currentImage.edit();
+    history.recordEdit(pixels, pendingBlurRect);
+    updateUndoButtons();
+    QPainter painter(&pixels);
+    painter.drawImage(pendingBlurRect, blurred);
+    painter.end();
     
-    for (int y = 0; y < image.height(); ++y) {
-        for (int x = 0; x < image.width(); ++x) {
-            int r = 0, g = 0, b = 0, a = 0;
-            int count = 0;
-            
-            // Sample pixels in a neighborhood defined by the radius
-            for (int dy = -radius; dy <= radius; ++dy) {
-                for (int dx = -radius; dx <= radius; ++dx) {
-                    int nx = x + dx;
-                    int ny = y + dy;
-                    
-                    // Check if the neighbor pixel is within bounds
-                    if (nx >= 0 && nx < image.width() && ny >= 0 && ny < image.height()) {
-                        QRgb pixel = image.pixel(nx, ny);
-                        r += qRed(pixel);
-                        g += qGreen(pixel);
-                        b += qBlue(pixel);
-                        a += qAlpha(pixel);
-                        count++;
-                    }
-                }
-            }
-            
-            // Calculate average values
-            if (count > 0) {
-                r /= count;
-                g /= count;
-                b /= count;
-                a /= count;
-                
-                blurred.setPixel(x, y, qRgba(r, g, b, a));
-            }
-        }
-    }
+    pendingBlurRect = QRect();
+    invalidateBlurPreview();
+    update();
     
-    image = blurred;
+    emitEdited();
+}
+
+// Blurs the image in place with the separable sliding-window engine
+void ImageEditor::blurImage(QImage &image, int radius)
+{
+    PROFILE_SCOPE("editor.blurImage");
+    BlurEngine::blur(image, radius, currentBlurQuality);
 }
 
 void ImageEditor::applyArrow()
 {
+    PROFILE_SCOPE("editor.applyArrow");
     if (!currentImage.isNull()) {
-        // Create a copy of the current image to modify
-        QPixmap result = currentImage;
-        QPainter painter(&result);
-        
-        // Set pen for arrow
-        QPen pen(currentColor, currentThickness);
-        pen.setCapStyle(Qt::RoundCap);
-        pen.setJoinStyle(Qt::RoundJoin);
-        painter.setPen(pen);
-        
-        // Draw the arrow line
-        painter.drawLine(startPoint, endPoint);
-        
-        // Draw arrowhead
-        double angle = std::atan2(static_cast<double>(endPoint.y() - startPoint.y()), 
-                                  static_cast<double>(endPoint.x() - startPoint.x()));
-        
-        // Calculate arrowhead points
-        double headLength = 10 + currentThickness; // Make arrowhead size proportional to thickness
-        QPointF arrowP1 = endPoint - QPointF(headLength * std::cos(angle - M_PI / 6), 
-                                            headLength * std::sin(angle - M_PI / 6));
-        QPointF arrowP2 = endPoint - QPointF(headLength * std::cos(angle + M_PI / 6), 
-                                            headLength * std::sin(angle + M_PI / 6));
-        
-        painter.drawLine(endPoint, arrowP1);
-        painter.drawLine(endPoint, arrowP2);
-        
-        currentImage = result;
-        
-        emit imageEdited(currentImage);
+        const QPoint offset = imageOffset();
+        addAnnotation(Annotation::arrow(startPoint - offset, endPoint - offset,
+                                        currentColor, currentThickness));
     }
 }
 
 void ImageEditor::applyText()
 {
+    PROFILE_SCOPE("editor.applyText");
     if (!currentImage.isNull() && !textLineEdit->text().isEmpty()) {
-        // Create a copy of the current image to modify
-        QPixmap result = currentImage;
-        QPainter painter(&result);
-        
-        // Set text properties
-        painter.setPen(QPen(currentColor, 1)); // Text color
-        painter.setFont(QFont("Arial", 16 + currentThickness)); // Size based on thickness setting
-        
-        // Draw the text at the start point
-        painter.drawText(startPoint, textLineEdit->text());
-        
-        currentImage = result;
+        // Size based on thickness setting
+        const int pointSize = 16 + currentThickness;
+        QImage pixels = currentImage.image();
+        addAnnotation(Annotation::label(startPoint - imageOffset(), textLineEdit->text(),
+                                        currentColor, pointSize, &pixels));
         
         // Hide text input and clear it
         textLineEdit->hide();
         textLineEdit->clear();
-        
-        emit imageEdited(currentImage);
     } else {
         // If no text was entered, just hide the input field
         textLineEdit->hide();
     }
 }
 
+// Adds to the display list; only the annotation's own area is repainted
+void ImageEditor::addAnnotation(const Annotation &annotation)
+{
+    history.recordAnnotations(annotations);
+    updateUndoButtons();
+    annotations.append(annotation);
+    update(annotation.bounds.translated(imageOffset()));
+}
+
+// Publishes the flattened image; the editor keeps the annotations editable
+void ImageEditor::emitEdited()
+{
+    emit imageEdited(exportImage());
+}
+
+// Pixels that differ when a rectangle overlay moves from 'before' to
+// 'after': the strips that entered or left it plus both outlines, each
+// 'border' pixels wide on either side of the edge
+QRegion ImageEditor::rectChange(const QRect &before, const QRect &after, int border)
+{
+    auto outline = [border](const QRect &rect) {
+        return QRegion(rect.adjusted(-border, -border, border, border))
+             - QRegion(rect.adjusted(border, border, -border, -border));
+    };
+    return QRegion(before).xored(QRegion(after)) + outline(before) + outline(after);
+}
+
+QPoint ImageEditor::imageOffset() const
+{
+    return QPoint((width() - currentImage.width()) / 2, (height() - currentImage.height()) / 2);
+}
+
 QRect ImageEditor::getNormalizedRect(const QPoint &p1, const QPoint &p2) const
 {
     int x1 = qMin(p1.x(), p2.x());
@@ -565,7 +724,9 @@ void ImageEditor::onToolSelected(EditTool tool)
     
     // Update button states
     for (auto child : toolbar->findChildren<QToolButton*>()) {
-        if (child->text() == "Crop") {
+        if (child->text() == "Select") {
+            child->setChecked(tool == EditTool::Select);
+        } else if (child->text() == "Crop") {
             child->setChecked(tool == EditTool::Crop);
         } else if (child->text() == "Blur") {
             child->setChecked(tool == EditTool::Blur);
@@ -600,6 +761,52 @@ void ImageEditor::onThicknessChanged(int thickness)
 void ImageEditor::onBlurRadiusChanged(int radius)
 {
     currentBlurRadius = radius;
+    invalidateBlurPreview();
+}
+
+void ImageEditor::onBlurQualityChanged(int index)
+{
+    currentBlurQuality = index == 0 ? BlurEngine::Quality::Box
+                                    : BlurEngine::Quality::Gaussian;
+    invalidateBlurPreview();
+}
+
+void ImageEditor::onUndo()
+{
+    if (blurWatcher->isRunning() || !history.undo(currentImage, annotations))
+        return;
+    invalidateBlurPreview();
+    updateUndoButtons();
+    update();
+    emitEdited();
+}
+
+void ImageEditor::onRedo()
+{
+    if (blurWatcher->isRunning() || !history.redo(currentImage, annotations))
+        return;
+    invalidateBlurPreview();
+    updateUndoButtons();
+    update();
+    emitEdited();
+}
+
+void ImageEditor::onDone()
+{
+    if (!currentImage.isNull())
+        emitEdited();
+}
+
+void ImageEditor::updateUndoButtons()
+{
+    undoButton->setEnabled(history.canUndo());
+    redoButton->setEnabled(history.canRedo());
+}
+
+void ImageEditor::setUndoMemoryBudget(qint64 bytes)
+{
+    history.setMemoryBudget(bytes);
+    updateUndoButtons();
 }
 
 void ImageEditor::onTextAdded(const QString &text)
@@ -611,20 +818,11 @@ void ImageEditor::onTextAdded(const QString &text)
 void ImageEditor::onTextEditingFinished()
 {
     if (!textLineEdit->text().isEmpty()) {
-        // Add text to the image
+        // Add text over the image
         if (!currentImage.isNull()) {
-            QPixmap result = currentImage;
-            QPainter painter(&result);
-            
-            // Set text properties
-            painter.setPen(QPen(currentColor, currentThickness));
-            painter.setFont(QFont("Arial", 16));
-            
-            // Draw the text at the start point
-            painter.drawText(startPoint, textLineEdit->text());
-            
-            currentImage = result;
-            emit imageEdited(currentImage);
+            QImage pixels = currentImage.image();
+            addAnnotation(Annotation::label(startPoint - imageOffset(), textLineEdit->text(),
+                                            currentColor, 16, &pixels));
         }
         
         textLineEdit->hide();
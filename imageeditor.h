@@ -21,6 +21,14 @@
 #include <QColorDialog>
 #include <QSpinBox>
 #include <QSlider>
+#include <QFutureWatcher>
+#include "annotationlayer.h"
+#include "blurengine.h"
+#include "imagebuffer.h"
+#include "undohistory.h"
+
+class QProgressBar;
+class QPushButton;
 
 enum class EditTool {
     Select,
@@ -38,19 +46,32 @@ public:
     explicit ImageEditor(QWidget *parent = nullptr);
     ~ImageEditor() override;
 
-    void setImage(const QPixmap &image);
-    QPixmap getImage() const;
+    void setImage(const ImageBuffer &image);
+    // The image with all annotations flattened into it
+    ImageBuffer getImage() const;
+    // Same, remembered as the editor's own result so that setImage() with
+    // it keeps the annotations editable
+    ImageBuffer exportImage();
+
+    // Memory cap for the undo history (UndoHistory::DefaultMemoryBudget)
+    void setUndoMemoryBudget(qint64 bytes);
 
 signals:
-    void imageEdited(const QPixmap &editedImage);
+    void imageEdited(const ImageBuffer &editedImage);
 
 private slots:
     void onToolSelected(EditTool tool);
     void onColorChanged();
     void onThicknessChanged(int thickness);
     void onBlurRadiusChanged(int radius);
+    void onBlurQualityChanged(int index);
     void onTextAdded(const QString &text);
     void onTextEditingFinished();
+    void onBlurProgress(int done, int total);
+    void onBlurFinished();
+    void onUndo();
+    void onRedo();
+    void onDone();
 
 private:
     void setupUI();
@@ -70,25 +91,50 @@ private:
     QRect getNormalizedRect(const QPoint &p1, const QPoint &p2) const;
     void updatePreview();
     void blurImage(QImage &image, int radius);
+    void finishBlur(const QImage &blurred);
+    void ensureBlurPreview();
+    void invalidateBlurPreview();
+    void updateUndoButtons();
+    void addAnnotation(const Annotation &annotation);
+    void emitEdited();
+    QPoint imageOffset() const;
+    static QRegion rectChange(const QRect &before, const QRect &after, int border);
 
-    QPixmap originalImage;
-    QPixmap currentImage;
-    QPixmap previewImage;
+    ImageBuffer currentImage;
+    AnnotationLayer annotations;    // kept as vectors until getImage()
+    ImageBuffer exportedImage;      // last image passed to imageEdited
+    UndoHistory history;
     
     EditTool currentTool;
     QPoint startPoint;
     QPoint endPoint;
     bool isDrawing;
     
+    // Moving annotations with the Select tool
+    int draggedAnnotation;
+    AnnotationLayer annotationsBeforeDrag;
+    
     // Editing properties
     QColor currentColor;
     int currentThickness;
     int currentBlurRadius;
+    BlurEngine::Quality currentBlurQuality;
     
     // UI elements
     QWidget *toolbar;
     QLineEdit *textLineEdit;
     QColorDialog *colorDialog;
+    QProgressBar *blurProgressBar;
+    QPushButton *undoButton;
+    QPushButton *redoButton;
+    
+    // Background blur of large regions
+    QFutureWatcher<QImage> *blurWatcher;
+    QRect pendingBlurRect;
+    
+    // Low-resolution blurred copy of the whole image for the live preview
+    QImage blurPreview;
+    int blurPreviewScale;
     
     // Crop handles
     QRect topLeftHandle;
@@ -0,0 +1,114 @@
+#include "imagepyramid.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#  define PYRAMID_HAVE_SSE2
+#  include <emmintrin.h>
+#endif
+
+namespace {
+
+// Rounded average of four pixels, two channels at a time per 32-bit word
+inline quint32 average4(quint32 a, quint32 b, quint32 c, quint32 d)
+{
+    const quint32 mask = 0x00ff00ffu;
+    const quint32 low = (a & mask) + (b & mask) + (c & mask) + (d & mask) + 0x00020002u;
+    const quint32 high = ((a >> 8) & mask) + ((b >> 8) & mask)
+                       + ((c >> 8) & mask) + ((d >> 8) & mask) + 0x00020002u;
+    return ((low >> 2) & mask) | (((high >> 2) & mask) << 8);
+}
+
+// Writes 'width' pixels, each the average of a 2x2 block of 'top' / 'bottom'
+void halveRow(const quint32 *top, const quint32 *bottom, quint32 *dst, int width)
+{
+    int x = 0;
+#ifdef PYRAMID_HAVE_SSE2
+    // Four output pixels per iteration: channels are widened to 16 bits,
+    // rows are added, then neighbouring pixels are added pairwise
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i rounding = _mm_set1_epi16(2);
+    for (; x + 4 <= width; x += 4) {
+        __m128i halves[2];
+        for (int i = 0; i < 2; ++i) {
+            const __m128i t = _mm_loadu_si128(reinterpret_cast<const __m128i *>(top + 2 * x + 4 * i));
+            const __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i *>(bottom + 2 * x + 4 * i));
+            const __m128i low = _mm_add_epi16(_mm_unpacklo_epi8(t, zero), _mm_unpacklo_epi8(b, zero));
+            const __m128i high = _mm_add_epi16(_mm_unpackhi_epi8(t, zero), _mm_unpackhi_epi8(b, zero));
+            const __m128i sum = _mm_add_epi16(_mm_unpacklo_epi64(low, high),
+                                              _mm_unpackhi_epi64(low, high));
+            halves[i] = _mm_srli_epi16(_mm_add_epi16(sum, rounding), 2);
+        }
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + x), _mm_packus_epi16(halves[0], halves[1]));
+    }
+#endif
+    for (; x < width; ++x)
+        dst[x] = average4(top[2 * x], top[2 * x + 1], bottom[2 * x], bottom[2 * x + 1]);
+}
+
+} // namespace
+
+ImagePyramid::ImagePyramid(const ImageBuffer &image)
+{
+    setImage(image);
+}
+
+void ImagePyramid::setImage(const ImageBuffer &image)
+{
+    levels.clear();
+    if (image.isNull())
+        return;
+
+    // Averaging needs 32-bit pixels; premultiplied alpha keeps it correct
+    QImage source = image.image();
+    if (source.format() != QImage::Format_RGB32
+            && source.format() != QImage::Format_ARGB32_Premultiplied)
+        source = source.convertToFormat(QImage::Format_ARGB32_Premultiplied);
+    levels.append(source);
+
+    while (levels.last().width() / 2 >= MinimumSide && levels.last().height() / 2 >= MinimumSide)
+        levels.append(halve(levels.last()));
+}
+
+void ImagePyramid::clear()
+{
+    levels.clear();
+}
+
+qint64 ImagePyramid::memoryUsage() const
+{
+    qint64 bytes = 0;
+    for (int i = 1; i < levels.size(); ++i)
+        bytes += qint64(levels.at(i).bytesPerLine()) * levels.at(i).height();
+    return bytes;
+}
+
+QImage ImagePyramid::scaled(const QSize &size, Qt::AspectRatioMode mode) const
+{
+    if (levels.isEmpty() || size.isEmpty())
+        return QImage();
+
+    const QSize target = levels.first().size().scaled(size, mode);
+    int index = 0;
+    while (index + 1 < levels.size()
+           && levels.at(index + 1).width() >= target.width()
+           && levels.at(index + 1).height() >= target.height())
+        ++index;
+
+    return levels.at(index).scaled(target, Qt::IgnoreAspectRatio, Qt::SmoothTransformation);
+}
+
+QImage ImagePyramid::halve(const QImage &image)
+{
+    if (image.width() < 2 || image.height() < 2)
+        return image;
+
+    const int width = image.width() / 2;
+    const int height = image.height() / 2;
+    QImage result(width, height, image.format());
+
+    for (int y = 0; y < height; ++y) {
+        halveRow(reinterpret_cast<const quint32 *>(image.constScanLine(2 * y)),
+                 reinterpret_cast<const quint32 *>(image.constScanLine(2 * y + 1)),
+                 reinterpret_cast<quint32 *>(result.scanLine(y)), width);
+    }
+    return result;
+}
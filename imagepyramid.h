@@ -0,0 +1,49 @@
+#ifndef IMAGEPYRAMID_H
+#define IMAGEPYRAMID_H
+
+#include <QImage>
+#include <QSize>
+#include <QVector>
+#include "imagebuffer.h"
+
+// Mipmap pyramid for fast downscaled previews.
+//
+// Level 0 is the source image itself (shared, not copied); every further
+// level halves both dimensions with a 2x2 box average, down to MinimumSide.
+// All reduced levels together take about a third of the source memory.
+// A preview is scaled smoothly from the smallest level that is still at
+// least as large as the target, so it never touches more than 4x the
+// target's pixels regardless of the capture size.
+class ImagePyramid
+{
+public:
+    static const int MinimumSide = 32;
+
+    ImagePyramid() {}
+    explicit ImagePyramid(const ImageBuffer &image);
+
+    // Rebuilds the levels for a new image
+    void setImage(const ImageBuffer &image);
+    void clear();
+
+    bool isNull() const { return levels.isEmpty(); }
+    int levelCount() const { return levels.size(); }
+    const QImage &level(int index) const { return levels.at(index); }
+
+    // Bytes used by the reduced levels (level 0 is not counted)
+    qint64 memoryUsage() const;
+
+    // Close to QImage::scaled(size, mode, Qt::SmoothTransformation) on the
+    // source, not identical: the levels are 2x box reductions, and the
+    // result is a smooth scale of the nearest level at or above 'size'
+    QImage scaled(const QSize &size, Qt::AspectRatioMode mode = Qt::KeepAspectRatio) const;
+
+    // One 2x2 box reduction of a 32-bit image; odd last rows/columns are
+    // dropped, images smaller than 2x2 are returned unchanged
+    static QImage halve(const QImage &image);
+
+private:
+    QVector<QImage> levels;
+};
+
+#endif // IMAGEPYRAMID_H
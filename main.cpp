@@ -1,17 +1,32 @@
 #include <QApplication>
+#include "commandline.h"
 #include "screenshottool.h"
+#include "profiler.h"
 
 int main(int argc, char *argv[])
 {
+    // Консольный режим: без окон и без задержки перед захватом
+    if (CommandLine::isRequested(argc, argv)) {
+        QGuiApplication app(argc, argv);
+        return CommandLine::run(app);
+    }
+    
     QApplication app(argc, argv);
     
     // Устанавливаем иконку приложения (опционально)
     // app.setWindowIcon(QIcon(":/icons/app.png"));
     
     ScreenshotTool tool;
+    // Только для startupbench: выход после первой отрисовки превью
+    tool.setExitAfterFirstPreview(qEnvironmentVariableIntValue("SCREENSHOTTOOL_STARTUP_PROBE") != 0);
     tool.setWindowTitle("📸 Скриншотер • Qt 5.12.12");
     tool.resize(600, 500);
     tool.show();
     
-    return app.exec();
+    const int result = app.exec();
+    
+    // SCREENSHOTTOOL_PROFILE=1: статистика горячих путей при выходе
+    if (Profiler::isEnabled())
+        Profiler::dumpJson(Profiler::defaultDumpPath());
+    return result;
 }
@@ -0,0 +1,153 @@
+#include "perceptualhash.h"
+#include "profiler.h"
+#include <QtAlgorithms>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#  define PHASH_HAVE_SSE2
+#  include <emmintrin.h>
+#endif
+
+namespace {
+
+const int kGridColumns = 9;
+const int kGridRows = 8;
+const int kMaxSampledRows = 512;
+
+// R+G+B of 'count' 32-bit pixels
+quint64 sumSpan(const uchar *pixels, int count)
+{
+    quint64 sum = 0;
+    int i = 0;
+#ifdef PHASH_HAVE_SSE2
+    // Alpha bytes masked out, then SAD against zero adds up each half of
+    // the register: 8 pixels per step in two independent chains
+    const __m128i mask = _mm_set1_epi32(0x00ffffff);
+    const __m128i zero = _mm_setzero_si128();
+    __m128i acc0 = zero;
+    __m128i acc1 = zero;
+    for (; i + 8 <= count; i += 8) {
+        const __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i *>(pixels + i * 4));
+        const __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i *>(pixels + i * 4 + 16));
+        acc0 = _mm_add_epi64(acc0, _mm_sad_epu8(_mm_and_si128(a, mask), zero));
+        acc1 = _mm_add_epi64(acc1, _mm_sad_epu8(_mm_and_si128(b, mask), zero));
+    }
+    quint64 lanes[2];
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(lanes), _mm_add_epi64(acc0, acc1));
+    sum = lanes[0] + lanes[1];
+#endif
+    for (; i < count; ++i) {
+        quint32 pixel;
+        memcpy(&pixel, pixels + i * 4, 4);
+        sum += qRed(pixel) + qGreen(pixel) + qBlue(pixel);
+    }
+    return sum;
+}
+
+quint64 packSize(const QSize &size)
+{
+    return quint64(quint32(size.width())) << 32 | quint32(size.height());
+}
+
+} // namespace
+
+namespace PerceptualHash {
+
+quint64 compute(const QImage &source)
+{
+    PROFILE_SCOPE("capture.hash");
+    if (source.isNull())
+        return 0;
+    QImage image = source.depth() == 32 ? source : source.convertToFormat(QImage::Format_RGB32);
+    if (image.width() < kGridColumns || image.height() < kGridRows) {
+        image = image.scaled(qMax(image.width(), kGridColumns), qMax(image.height(), kGridRows),
+                             Qt::IgnoreAspectRatio, Qt::FastTransformation);
+    }
+    return computeBits(image.constBits(), image.bytesPerLine(), image.width(), image.height());
+}
+
+quint64 computeBits(const uchar *bits, int bytesPerLine, int width, int height)
+{
+    if (!bits || width < kGridColumns || height < kGridRows)
+        return 0;
+
+    int columnStart[kGridColumns + 1];
+    for (int c = 0; c <= kGridColumns; ++c)
+        columnStart[c] = int(qint64(c) * width / kGridColumns);
+
+    // Rows sampled at the centres of equal bands; all rows of small images
+    quint64 sums[kGridRows][kGridColumns] = {};
+    const int sampled = qMin(height, kMaxSampledRows);
+    for (int s = 0; s < sampled; ++s) {
+        const int y = int((2 * qint64(s) + 1) * height / (2 * sampled));
+        const int gridRow = int(qint64(y) * kGridRows / height);
+        const uchar *row = bits + qptrdiff(y) * bytesPerLine;
+        for (int c = 0; c < kGridColumns; ++c) {
+            sums[gridRow][c] += sumSpan(row + columnStart[c] * 4,
+                                        columnStart[c + 1] - columnStart[c]);
+        }
+    }
+
+    // Cells of one grid row share their row count; comparing averages then
+    // only needs the cell widths, cross-multiplied to stay in integers
+    quint64 hash = 0;
+    for (int r = 0; r < kGridRows; ++r) {
+        for (int c = 0; c < kGridColumns - 1; ++c) {
+            const quint64 leftWidth = quint64(columnStart[c + 1] - columnStart[c]);
+            const quint64 rightWidth = quint64(columnStart[c + 2] - columnStart[c + 1]);
+            if (sums[r][c] * rightWidth > sums[r][c + 1] * leftWidth)
+                hash |= quint64(1) << (r * 8 + c);
+        }
+    }
+    return hash;
+}
+
+int distance(quint64 a, quint64 b)
+{
+    return int(qPopulationCount(a ^ b));
+}
+
+} // namespace PerceptualHash
+
+void DuplicateIndex::insert(quint64 id, quint64 hash, const QSize &size)
+{
+    ids.append(id);
+    hashes.append(hash);
+    sizes.append(packSize(size));
+}
+
+void DuplicateIndex::remove(quint64 id)
+{
+    const int index = ids.indexOf(id);
+    if (index >= 0) {
+        ids.remove(index);
+        hashes.remove(index);
+        sizes.remove(index);
+    }
+}
+
+void DuplicateIndex::clear()
+{
+    ids.clear();
+    hashes.clear();
+    sizes.clear();
+}
+
+DuplicateIndex::Match DuplicateIndex::nearest(quint64 hash, const QSize &size, int maxDistance) const
+{
+    Match match = { 0, maxDistance + 1 };
+    const quint64 packed = packSize(size);
+    const quint64 *data = hashes.constData();
+    const quint64 *dataSizes = sizes.constData();
+    for (int i = hashes.size() - 1; i >= 0 && match.distance > 0; --i) {
+        if (dataSizes[i] != packed)
+            continue;
+        const int d = PerceptualHash::distance(data[i], hash);
+        if (d < match.distance) {
+            match.id = ids.at(i);
+            match.distance = d;
+        }
+    }
+    if (match.id == 0)
+        match.distance = -1;
+    return match;
+}
@@ -0,0 +1,60 @@
+#ifndef PERCEPTUALHASH_H
+#define PERCEPTUALHASH_H
+
+#include <QImage>
+#include <QSize>
+#include <QVector>
+
+// Difference hash (dHash) of a capture, for finding near-duplicates.
+//
+// The image is reduced to a 9x8 grid of cell averages of R+G+B, and bit
+// (row * 8 + column) is set when a cell is brighter than its right
+// neighbour. Re-capturing an unchanged screen gives the same hash; a
+// blinking cursor or a clock flips a few bits at most, while a different
+// window or page changes many. Captures with the same layout but other
+// text can hash alike, so callers flag near-duplicates rather than trust
+// them blindly.
+namespace PerceptualHash {
+
+// Hamming distance at or below which two captures count as near-duplicates
+const int NearDuplicateDistance = 4;
+
+quint64 compute(const QImage &image);
+
+// Same on raw 32-bit pixels (alpha ignored). Large images sample up to
+// 512 evenly spaced rows; each row is summed with SSE2 when available,
+// with results identical to the portable version.
+quint64 computeBits(const uchar *bits, int bytesPerLine, int width, int height);
+
+int distance(quint64 a, quint64 b);
+
+} // namespace PerceptualHash
+
+// Hashes of the captures kept in an archive, packed for a linear scan:
+// a few thousand 64-bit XOR + popcount steps take microseconds. Only
+// captures of the same size are compared, since the 9x8 grid of a region
+// capture can match a full screen with a similar layout.
+class DuplicateIndex
+{
+public:
+    struct Match {
+        quint64 id;     // 0 when nothing is close enough
+        int distance;   // -1 without a match
+    };
+
+    void insert(quint64 id, quint64 hash, const QSize &size);
+    void remove(quint64 id);
+    void clear();
+    int count() const { return ids.size(); }
+
+    // Closest entry of 'size' within 'maxDistance'; the newest one on ties
+    Match nearest(quint64 hash, const QSize &size,
+                  int maxDistance = PerceptualHash::NearDuplicateDistance) const;
+
+private:
+    QVector<quint64> ids;
+    QVector<quint64> hashes;
+    QVector<quint64> sizes;     // width << 32 | height
+};
+
+#endif // PERCEPTUALHASH_H
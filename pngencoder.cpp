@@ -0,0 +1,303 @@
+#include "pngencoder.h"
+#include "profiler.h"
+#include <QThread>
+#include <QThreadPool>
+#include <QtConcurrent>
+#include <cstdlib>
+
+#ifdef Q_OS_WIN
+#  include <QtZlib/zlib.h>
+#else
+#  include <zlib.h>
+#endif
+
+namespace {
+
+// Raw bytes per strip; pigz uses 128 KB blocks, larger strips keep the
+// sync-flush overhead negligible on big screenshots
+const int kStripBytes = 256 * 1024;
+const int kWindowBytes = 32 * 1024;
+
+enum FilterType { FilterNone, FilterSub, FilterUp, FilterAverage, FilterPaeth, FilterCount };
+
+struct Strip {
+    int first;
+    int rows;
+    QByteArray deflated;
+    uLong adler;
+    uLong filteredBytes;
+    bool ok;
+};
+
+inline uchar paeth(int a, int b, int c)
+{
+    const int p = a + b - c;
+    const int pa = std::abs(p - a);
+    const int pb = std::abs(p - b);
+    const int pc = std::abs(p - c);
+    if (pa <= pb && pa <= pc)
+        return uchar(a);
+    return pb <= pc ? uchar(b) : uchar(c);
+}
+
+// One filtered row: filter type, then the filtered bytes. 'previous' is the
+// unfiltered row above, nullptr for the first row of the image.
+void filterRow(FilterType type, const uchar *row, const uchar *previous,
+               int rowBytes, int bpp, uchar *out)
+{
+    *out++ = uchar(type);
+    for (int i = 0; i < rowBytes; ++i) {
+        const int left = i >= bpp ? row[i - bpp] : 0;
+        const int up = previous ? previous[i] : 0;
+        const int upLeft = previous && i >= bpp ? previous[i - bpp] : 0;
+        switch (type) {
+        case FilterNone: out[i] = row[i]; break;
+        case FilterSub: out[i] = uchar(row[i] - left); break;
+        case FilterUp: out[i] = uchar(row[i] - up); break;
+        case FilterAverage: out[i] = uchar(row[i] - ((left + up) >> 1)); break;
+        default: out[i] = uchar(row[i] - paeth(left, up, upLeft)); break;
+        }
+    }
+}
+
+// libpng's heuristic: the filter with the smallest sum of absolute signed
+// bytes. The fast levels use Sub only, which is cheap and fine for UI.
+void filterBest(const uchar *row, const uchar *previous, int rowBytes, int bpp,
+                bool adaptive, uchar *out, QByteArray &scratch)
+{
+    if (!adaptive) {
+        filterRow(FilterSub, row, previous, rowBytes, bpp, out);
+        return;
+    }
+
+    scratch.resize(rowBytes + 1);
+    uchar *candidate = reinterpret_cast<uchar *>(scratch.data());
+    quint64 bestSum = ~quint64(0);
+    for (int type = FilterNone; type < FilterCount; ++type) {
+        filterRow(FilterType(type), row, previous, rowBytes, bpp, candidate);
+        quint64 sum = 0;
+        for (int i = 1; i <= rowBytes; ++i)
+            sum += quint64(std::abs(int(qint8(candidate[i]))));
+        if (sum < bestSum) {
+            bestSum = sum;
+            memcpy(out, candidate, size_t(rowBytes) + 1);
+        }
+    }
+}
+
+// Filters rows [first, first + rows) of 'image' into 'out'
+void filterRows(const QImage &image, int first, int rows, int bpp, bool adaptive, uchar *out)
+{
+    const int rowBytes = image.width() * bpp;
+    QByteArray scratch;
+    for (int y = first; y < first + rows; ++y) {
+        filterBest(image.constScanLine(y), y > 0 ? image.constScanLine(y - 1) : nullptr,
+                   rowBytes, bpp, adaptive, out, scratch);
+        out += rowBytes + 1;
+    }
+}
+
+void deflateStrip(const QImage &image, int bpp, int level, bool last, Strip &strip)
+{
+    PROFILE_SCOPE("png.strip");
+    const int rowBytes = image.width() * bpp;
+    const int filteredRow = rowBytes + 1;
+    const bool adaptive = level > 2;
+
+    QByteArray filtered;
+    filtered.resize(strip.rows * filteredRow);
+    filterRows(image, strip.first, strip.rows, bpp, adaptive,
+               reinterpret_cast<uchar *>(filtered.data()));
+    strip.filteredBytes = uLong(filtered.size());
+    strip.adler = adler32(adler32(0L, Z_NULL, 0),
+                          reinterpret_cast<const Bytef *>(filtered.constData()), uInt(filtered.size()));
+
+    z_stream stream;
+    memset(&stream, 0, sizeof(stream));
+    if (deflateInit2(&stream, level, Z_DEFLATED, -MAX_WBITS, 8,
+                     adaptive ? Z_FILTERED : Z_DEFAULT_STRATEGY) != Z_OK) {
+        strip.ok = false;
+        return;
+    }
+
+    // The rows before the strip are what a decoder has in its window here
+    if (strip.first > 0) {
+        const int dictionaryRows = qMin(strip.first, (kWindowBytes + filteredRow - 1) / filteredRow);
+        QByteArray dictionary;
+        dictionary.resize(dictionaryRows * filteredRow);
+        filterRows(image, strip.first - dictionaryRows, dictionaryRows, bpp, adaptive,
+                   reinterpret_cast<uchar *>(dictionary.data()));
+        const int size = qMin(dictionary.size(), kWindowBytes);
+        deflateSetDictionary(&stream,
+                             reinterpret_cast<const Bytef *>(dictionary.constData() + dictionary.size() - size),
+                             uInt(size));
+    }
+
+    strip.deflated.resize(int(deflateBound(&stream, uLong(filtered.size()))) + 16);
+    stream.next_in = reinterpret_cast<Bytef *>(filtered.data());
+    stream.avail_in = uInt(filtered.size());
+    stream.next_out = reinterpret_cast<Bytef *>(strip.deflated.data());
+    stream.avail_out = uInt(strip.deflated.size());
+
+    // Sync flush ends the strip on a byte boundary without ending the
+    // stream; only the last strip sets the final-block bit
+    const int flush = last ? Z_FINISH : Z_SYNC_FLUSH;
+    int status = deflate(&stream, flush);
+    while ((last ? status != Z_STREAM_END : stream.avail_out == 0) && status != Z_STREAM_ERROR) {
+        const int used = strip.deflated.size() - int(stream.avail_out);
+        strip.deflated.resize(strip.deflated.size() * 2);
+        stream.next_out = reinterpret_cast<Bytef *>(strip.deflated.data() + used);
+        stream.avail_out = uInt(strip.deflated.size() - used);
+        status = deflate(&stream, flush);
+    }
+    strip.ok = status != Z_STREAM_ERROR;
+    strip.deflated.resize(int(stream.total_out));
+    deflateEnd(&stream);
+}
+
+void appendBigEndian(QByteArray &bytes, quint32 value)
+{
+    bytes.append(char(value >> 24));
+    bytes.append(char(value >> 16));
+    bytes.append(char(value >> 8));
+    bytes.append(char(value));
+}
+
+// One pool for the strips of every write: concurrent saves (SaveQueue runs
+// several) share the cores instead of each starting idealThreadCount threads.
+// Never deleted, like QThreadPool::globalInstance() it lives until exit.
+QThreadPool &stripPool()
+{
+    static QThreadPool *pool = [] {
+        QThreadPool *instance = new QThreadPool;
+        instance->setMaxThreadCount(QThread::idealThreadCount());
+        return instance;
+    }();
+    return *pool;
+}
+
+bool writeChunk(QIODevice *device, const char type[4], const QByteArray &prefix,
+                const QByteArray &data, const QByteArray &suffix)
+{
+    QByteArray header;
+    appendBigEndian(header, quint32(prefix.size() + data.size() + suffix.size()));
+    header.append(type, 4);
+
+    uLong crc = crc32(0L, Z_NULL, 0);
+    crc = crc32(crc, reinterpret_cast<const Bytef *>(type), 4);
+    crc = crc32(crc, reinterpret_cast<const Bytef *>(prefix.constData()), uInt(prefix.size()));
+    crc = crc32(crc, reinterpret_cast<const Bytef *>(data.constData()), uInt(data.size()));
+    crc = crc32(crc, reinterpret_cast<const Bytef *>(suffix.constData()), uInt(suffix.size()));
+    QByteArray trailer;
+    appendBigEndian(trailer, quint32(crc));
+
+    return device->write(header) == header.size()
+        && (prefix.isEmpty() || device->write(prefix) == prefix.size())
+        && (data.isEmpty() || device->write(data) == data.size())
+        && (suffix.isEmpty() || device->write(suffix) == suffix.size())
+        && device->write(trailer) == trailer.size();
+}
+
+} // namespace
+
+namespace PngEncoder {
+
+int levelForQuality(int quality)
+{
+    if (quality < 0)
+        return DefaultLevel;
+    // Same mapping as Qt's PNG handler
+    return (100 - qMin(quality, 100)) * 9 / 91;
+}
+
+bool write(const QImage &source, QIODevice *device, int level, int threadCount, QString *error)
+{
+    PROFILE_SCOPE("png.encode");
+    if (source.isNull()) {
+        if (error)
+            *error = "Empty image";
+        return false;
+    }
+
+    const bool alpha = source.hasAlphaChannel();
+    const QImage image = source.convertToFormat(alpha ? QImage::Format_RGBA8888 : QImage::Format_RGB888);
+    const int bpp = alpha ? 4 : 3;
+    const int rowBytes = image.width() * bpp;
+    level = qBound(0, level, 9);
+
+    // Strips of whole rows, at least as many as threads when possible
+    if (threadCount <= 0)
+        threadCount = QThread::idealThreadCount();
+    const int stripRows = qBound(1, qMin(kStripBytes / qMax(1, rowBytes), image.height() / threadCount),
+                                 image.height());
+    QVector<Strip> strips;
+    for (int first = 0; first < image.height(); first += stripRows) {
+        Strip strip;
+        strip.first = first;
+        strip.rows = qMin(stripRows, image.height() - first);
+        strip.ok = false;
+        strips.append(strip);
+    }
+
+    // At most 'threadCount' workers; worker w deflates strips w, w + workers, ...
+    const int lastIndex = strips.size() - 1;
+    const int workers = qMin(threadCount, strips.size());
+    QList<QFuture<void> > futures;
+    for (int w = 0; w < workers; ++w) {
+        futures.append(QtConcurrent::run(&stripPool(), [&image, &strips, bpp, level, lastIndex,
+                                                         w, workers]() {
+            for (int i = w; i <= lastIndex; i += workers)
+                deflateStrip(image, bpp, level, i == lastIndex, strips[i]);
+        }));
+    }
+    for (QFuture<void> &future : futures)
+        future.waitForFinished();
+
+    uLong adler = adler32(0L, Z_NULL, 0);
+    for (const Strip &strip : strips) {
+        if (!strip.ok) {
+            if (error)
+                *error = "zlib compression failed";
+            return false;
+        }
+        adler = adler32_combine(adler, strip.adler, z_off_t(strip.filteredBytes));
+    }
+
+    static const char signature[] = "\x89PNG\r\n\x1a\n";
+    QByteArray header;
+    appendBigEndian(header, quint32(image.width()));
+    appendBigEndian(header, quint32(image.height()));
+    header.append(char(8));                 // bit depth
+    header.append(char(alpha ? 6 : 2));     // RGBA / RGB
+    header.append(char(0));                 // deflate
+    header.append(char(0));                 // adaptive filtering
+    header.append(char(0));                 // no interlace
+
+    // zlib header with the level hint that matches 'level'
+    QByteArray zlibHeader;
+    zlibHeader.append(char(0x78));
+    zlibHeader.append(char(level < 2 ? 0x01 : level < 6 ? 0x5e : level == 6 ? 0x9c : 0xda));
+    QByteArray zlibTrailer;
+    appendBigEndian(zlibTrailer, quint32(adler));
+
+    bool ok = device->write(signature, 8) == 8
+           && writeChunk(device, "IHDR", QByteArray(), header, QByteArray());
+    if (ok && image.dotsPerMeterX() > 0 && image.dotsPerMeterY() > 0) {
+        QByteArray density;
+        appendBigEndian(density, quint32(image.dotsPerMeterX()));
+        appendBigEndian(density, quint32(image.dotsPerMeterY()));
+        density.append(char(1));            // per metre
+        ok = writeChunk(device, "pHYs", QByteArray(), density, QByteArray());
+    }
+    for (int i = 0; ok && i < strips.size(); ++i) {
+        ok = writeChunk(device, "IDAT", i == 0 ? zlibHeader : QByteArray(), strips.at(i).deflated,
+                        i == lastIndex ? zlibTrailer : QByteArray());
+    }
+    ok = ok && writeChunk(device, "IEND", QByteArray(), QByteArray(), QByteArray());
+
+    if (!ok && error)
+        *error = device->errorString();
+    return ok;
+}
+
+} // namespace PngEncoder
@@ -0,0 +1,36 @@
+#ifndef PNGENCODER_H
+#define PNGENCODER_H
+
+#include <QImage>
+#include <QIODevice>
+#include <QString>
+
+// PNG writer that filters and deflates horizontal strips of rows on several
+// cores, pigz-style, and still produces one standard zlib stream.
+//
+// Each strip is deflated as raw deflate ending in a sync flush, primed with
+// the last 32 KB of the filtered rows before it as a dictionary, so the
+// compression ratio stays close to a single-stream encoder. The strips are
+// written as consecutive IDAT chunks behind one zlib header; the Adler-32
+// of the whole stream is combined from the per-strip checksums.
+//
+// Opaque images are written as 8-bit RGB, images with alpha as 8-bit
+// non-premultiplied RGBA.
+namespace PngEncoder {
+
+const int FastestLevel = 1;
+const int DefaultLevel = 6;
+const int SmallestLevel = 9;
+
+// zlib level for a QImageWriter PNG quality (0-100, higher = faster and
+// larger); -1 gives DefaultLevel
+int levelForQuality(int quality);
+
+// Up to 'threadCount' strips at a time (0 = QThread::idealThreadCount()),
+// on a pool shared by all writes and capped at idealThreadCount()
+bool write(const QImage &image, QIODevice *device, int level = DefaultLevel,
+           int threadCount = 0, QString *error = nullptr);
+
+} // namespace PngEncoder
+
+#endif // PNGENCODER_H
@@ -0,0 +1,198 @@
+#include "profiler.h"
+#include <QAtomicInt>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QMap>
+#include <QMutex>
+#include <QRegion>
+#include <QSaveFile>
+#include <QStringList>
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+// Bucket b covers durations up to 2^((b + 1) / 4) ns; 160 buckets reach
+// about 18 minutes
+const int kBucketsPerOctave = 4;
+const int kBucketCount = 160;
+
+struct Histogram {
+    Histogram()
+        : count(0), totalNs(0), minNs(0), maxNs(0), pixelFrames(0), totalPixels(0),
+          buckets(kBucketCount, 0) {}
+
+    qint64 count;
+    qint64 totalNs;
+    qint64 minNs;
+    qint64 maxNs;
+    qint64 pixelFrames;
+    qint64 totalPixels;
+    QVector<qint64> buckets;
+};
+
+QAtomicInt enabledFlag(qEnvironmentVariableIntValue("SCREENSHOTTOOL_PROFILE") != 0);
+QMutex histogramsMutex;
+
+QMap<QString, Histogram> &histograms()
+{
+    static QMap<QString, Histogram> instance;
+    return instance;
+}
+
+int bucketFor(qint64 ns)
+{
+    if (ns <= 1)
+        return 0;
+    const int bucket = int(std::log2(double(ns)) * kBucketsPerOctave);
+    return qBound(0, bucket, kBucketCount - 1);
+}
+
+qint64 bucketUpperBound(int bucket)
+{
+    return qint64(std::exp2(double(bucket + 1) / kBucketsPerOctave));
+}
+
+// Upper bound of the bucket holding the given percentile, clamped to the
+// observed range
+qint64 percentile(const Histogram &histogram, double fraction)
+{
+    const qint64 rank = qMax<qint64>(1, qint64(std::ceil(histogram.count * fraction)));
+    qint64 seen = 0;
+    for (int bucket = 0; bucket < kBucketCount; ++bucket) {
+        seen += histogram.buckets.at(bucket);
+        if (seen >= rank)
+            return qBound(histogram.minNs, bucketUpperBound(bucket), histogram.maxNs);
+    }
+    return histogram.maxNs;
+}
+
+double toMs(qint64 ns)
+{
+    return ns / 1e6;
+}
+
+} // namespace
+
+namespace Profiler {
+
+bool isEnabled()
+{
+    return enabledFlag.loadAcquire() != 0;
+}
+
+void setEnabled(bool enabled)
+{
+    enabledFlag.storeRelease(enabled ? 1 : 0);
+}
+
+void record(const char *name, qint64 ns)
+{
+    QMutexLocker locker(&histogramsMutex);
+    Histogram &histogram = histograms()[QString::fromLatin1(name)];
+    if (histogram.count == 0 || ns < histogram.minNs)
+        histogram.minNs = ns;
+    histogram.maxNs = qMax(histogram.maxNs, ns);
+    ++histogram.count;
+    histogram.totalNs += ns;
+    ++histogram.buckets[bucketFor(ns)];
+}
+
+void recordPixels(const char *name, const QRegion &painted)
+{
+    if (!isEnabled())
+        return;
+
+    qint64 pixels = 0;
+    for (const QRect &rect : painted)
+        pixels += qint64(rect.width()) * rect.height();
+
+    QMutexLocker locker(&histogramsMutex);
+    Histogram &histogram = histograms()[QString::fromLatin1(name)];
+    ++histogram.pixelFrames;
+    histogram.totalPixels += pixels;
+}
+
+void reset()
+{
+    QMutexLocker locker(&histogramsMutex);
+    histograms().clear();
+}
+
+QVector<Stats> snapshot()
+{
+    QMutexLocker locker(&histogramsMutex);
+    QVector<Stats> result;
+    for (auto it = histograms().constBegin(); it != histograms().constEnd(); ++it) {
+        const Histogram &histogram = it.value();
+        Stats stats;
+        stats.name = it.key();
+        stats.count = histogram.count;
+        stats.minNs = histogram.minNs;
+        stats.maxNs = histogram.maxNs;
+        stats.avgNs = histogram.totalNs / qMax<qint64>(1, histogram.count);
+        stats.p50Ns = percentile(histogram, 0.50);
+        stats.p99Ns = percentile(histogram, 0.99);
+        stats.avgPixels = histogram.totalPixels / qMax<qint64>(1, histogram.pixelFrames);
+        result.append(stats);
+    }
+    return result;
+}
+
+QByteArray toJson()
+{
+    QJsonArray timers;
+    for (const Stats &stats : snapshot()) {
+        QJsonObject timer;
+        timer.insert("name", stats.name);
+        timer.insert("count", double(stats.count));
+        timer.insert("min_ms", toMs(stats.minNs));
+        timer.insert("avg_ms", toMs(stats.avgNs));
+        timer.insert("p50_ms", toMs(stats.p50Ns));
+        timer.insert("p99_ms", toMs(stats.p99Ns));
+        timer.insert("max_ms", toMs(stats.maxNs));
+        if (stats.avgPixels > 0)
+            timer.insert("avg_px", double(stats.avgPixels));
+        timers.append(timer);
+    }
+
+    QJsonObject root;
+    root.insert("timers", timers);
+    return QJsonDocument(root).toJson(QJsonDocument::Indented);
+}
+
+QString defaultDumpPath()
+{
+    const QString path = qEnvironmentVariable("SCREENSHOTTOOL_PROFILE_OUT");
+    return path.isEmpty() ? QString("screenshottool-profile.json") : path;
+}
+
+bool dumpJson(const QString &path)
+{
+    QSaveFile file(path);
+    if (!file.open(QIODevice::WriteOnly))
+        return false;
+    file.write(toJson());
+    return file.commit();
+}
+
+QString summary(int maxEntries)
+{
+    QVector<Stats> stats = snapshot();
+    std::sort(stats.begin(), stats.end(), [](const Stats &a, const Stats &b) {
+        return a.avgNs > b.avgNs;
+    });
+
+    QStringList parts;
+    for (int i = 0; i < stats.size() && i < maxEntries; ++i) {
+        parts << QString("%1 %2/%3 ms ×%4")
+                 .arg(stats.at(i).name)
+                 .arg(toMs(stats.at(i).p50Ns), 0, 'f', 1)
+                 .arg(toMs(stats.at(i).p99Ns), 0, 'f', 1)
+                 .arg(stats.at(i).count);
+    }
+    return parts.join(" • ");
+}
+
+} // namespace Profiler
@@ -0,0 +1,85 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <QByteArray>
+#include <QElapsedTimer>
+#include <QString>
+#include <QVector>
+
+class QRegion;
+
+// Scoped timers for the application's hot paths.
+//
+// PROFILE_SCOPE("name") measures the rest of the enclosing block and adds
+// the duration to a per-name log2 histogram (four buckets per doubling,
+// about 19% resolution). Profiling is off unless SCREENSHOTTOOL_PROFILE=1
+// is set or setEnabled(true) is called; a disabled timer only tests a flag.
+// Recording is thread-safe, so timers may run on pool threads.
+//
+// Paint timers also count the pixels each frame repainted (recordPixels),
+// which shows whether a frame's cost follows the size of the change or the
+// size of the screen; their maximum is the worst frame.
+namespace Profiler {
+
+struct Stats {
+    QString name;
+    qint64 count;
+    qint64 minNs;
+    qint64 maxNs;
+    qint64 avgNs;
+    qint64 p50Ns;
+    qint64 p99Ns;
+    qint64 avgPixels;   // per recordPixels() call; 0 for plain timers
+};
+
+bool isEnabled();
+void setEnabled(bool enabled);
+
+void record(const char *name, qint64 ns);
+// Adds the area of 'painted' to the timer 'name'; no-op while disabled
+void recordPixels(const char *name, const QRegion &painted);
+void reset();
+
+// One entry per timer name, sorted by name
+QVector<Stats> snapshot();
+
+// {"timers": [{"name", "count", "min_ms", "avg_ms", "p50_ms", "p99_ms", "max_ms"}]},
+// plus "avg_px" for timers with pixel counts
+QByteArray toJson();
+bool dumpJson(const QString &path);
+// SCREENSHOTTOOL_PROFILE_OUT, or screenshottool-profile.json
+QString defaultDumpPath();
+
+// Short one-line summary for the status bar, slowest average first
+QString summary(int maxEntries = 3);
+
+class ScopedTimer
+{
+public:
+    explicit ScopedTimer(const char *name)
+        : name(isEnabled() ? name : nullptr)
+    {
+        if (this->name)
+            timer.start();
+    }
+
+    ~ScopedTimer()
+    {
+        if (name)
+            record(name, timer.nsecsElapsed());
+    }
+
+private:
+    Q_DISABLE_COPY(ScopedTimer)
+
+    const char *name;
+    QElapsedTimer timer;
+};
+
+} // namespace Profiler
+
+#define PROFILE_CONCAT_(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_(a, b)
+#define PROFILE_SCOPE(name) Profiler::ScopedTimer PROFILE_CONCAT(profileScope, __LINE__)(name)
+
+#endif // PROFILER_H
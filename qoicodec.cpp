@@ -0,0 +1,290 @@
+#include "qoicodec.h"
+#include "profiler.h"
+#include <QScopedPointer>
+
+namespace {
+
+const char kMagic[4] = { 'q', 'o', 'i', 'f' };
+const int kHeaderSize = 14;
+const char kEndMarker[8] = { 0, 0, 0, 0, 0, 0, 0, 1 };
+// Refuse headers that would allocate more than this many pixels
+const qint64 kMaxPixels = 400000000;
+const int kBufferSize = 64 * 1024;
+
+enum {
+    OpIndex = 0x00,
+    OpDiff = 0x40,
+    OpLuma = 0x80,
+    OpRun = 0xc0,
+    OpRgb = 0xfe,
+    OpRgba = 0xff,
+    OpMask = 0xc0
+};
+
+inline int indexOf(QRgb pixel)
+{
+    return (qRed(pixel) * 3 + qGreen(pixel) * 5 + qBlue(pixel) * 7 + qAlpha(pixel) * 11) % 64;
+}
+
+void putBigEndian(uchar *out, quint32 value)
+{
+    out[0] = uchar(value >> 24);
+    out[1] = uchar(value >> 16);
+    out[2] = uchar(value >> 8);
+    out[3] = uchar(value);
+}
+
+quint32 getBigEndian(const uchar *in)
+{
+    return quint32(in[0]) << 24 | quint32(in[1]) << 16 | quint32(in[2]) << 8 | in[3];
+}
+
+// Output buffer that is flushed to the device whenever it fills up
+class Writer
+{
+public:
+    explicit Writer(QIODevice *device) : device(device), used(0), failed(false) {}
+
+    // Room for at least 'bytes' more; the longest op is 5 bytes
+    uchar *reserve(int bytes)
+    {
+        if (used + bytes > kBufferSize)
+            flush();
+        return buffer + used;
+    }
+    void commit(int bytes) { used += bytes; }
+    void put(uchar byte) { *reserve(1) = byte; ++used; }
+
+    bool flush()
+    {
+        if (used > 0 && device->write(reinterpret_cast<const char *>(buffer), used) != used)
+            failed = true;
+        used = 0;
+        return !failed;
+    }
+
+private:
+    QIODevice *device;
+    uchar buffer[kBufferSize];
+    int used;
+    bool failed;
+};
+
+// Input buffer refilled from the device; reads past the end return 0
+class Reader
+{
+public:
+    explicit Reader(QIODevice *device) : device(device), pos(0), size(0), exhausted(false) {}
+
+    uchar get()
+    {
+        if (pos == size && !refill())
+            return 0;
+        return buffer[pos++];
+    }
+    bool atEnd() const { return exhausted; }
+
+private:
+    bool refill()
+    {
+        const qint64 read = device->read(reinterpret_cast<char *>(buffer), kBufferSize);
+        pos = 0;
+        size = read > 0 ? int(read) : 0;
+        exhausted = size == 0;
+        return !exhausted;
+    }
+
+    QIODevice *device;
+    uchar buffer[kBufferSize];
+    int pos;
+    int size;
+    bool exhausted;
+};
+
+} // namespace
+
+namespace QoiCodec {
+
+bool canRead(const QByteArray &header)
+{
+    return header.size() >= 4 && memcmp(header.constData(), kMagic, 4) == 0;
+}
+
+bool write(const QImage &source, QIODevice *device, QString *error)
+{
+    PROFILE_SCOPE("qoi.encode");
+    if (source.isNull()) {
+        if (error)
+            *error = "Empty image";
+        return false;
+    }
+
+    const bool alpha = source.hasAlphaChannel();
+    const QImage::Format format = alpha ? QImage::Format_ARGB32 : QImage::Format_RGB32;
+    const QImage image = source.format() == format ? source : source.convertToFormat(format);
+
+    // Large buffer: a member array would not fit on a worker's stack
+    QScopedPointer<Writer> writer(new Writer(device));
+    uchar *header = writer->reserve(kHeaderSize);
+    memcpy(header, kMagic, 4);
+    putBigEndian(header + 4, quint32(image.width()));
+    putBigEndian(header + 8, quint32(image.height()));
+    header[12] = alpha ? 4 : 3;
+    header[13] = 0;     // sRGB with linear alpha
+    writer->commit(kHeaderSize);
+
+    QRgb index[64] = {};
+    QRgb previous = qRgba(0, 0, 0, 255);
+    int run = 0;
+    for (int y = 0; y < image.height(); ++y) {
+        const QRgb *row = reinterpret_cast<const QRgb *>(image.constScanLine(y));
+        for (int x = 0; x < image.width(); ++x) {
+            // RGB32 leaves the alpha byte at 0xff, as QOI expects for 3 channels
+            const QRgb pixel = row[x];
+            if (pixel == previous) {
+                if (++run == 62) {
+                    writer->put(uchar(OpRun | (run - 1)));
+                    run = 0;
+                }
+                continue;
+            }
+            if (run > 0) {
+                writer->put(uchar(OpRun | (run - 1)));
+                run = 0;
+            }
+
+            const int slot = indexOf(pixel);
+            if (index[slot] == pixel) {
+                writer->put(uchar(OpIndex | slot));
+            } else {
+                index[slot] = pixel;
+                uchar *out = writer->reserve(5);
+                int length;
+                if (qAlpha(pixel) == qAlpha(previous)) {
+                    const int dr = qint8(qRed(pixel) - qRed(previous));
+                    const int dg = qint8(qGreen(pixel) - qGreen(previous));
+                    const int db = qint8(qBlue(pixel) - qBlue(previous));
+                    const int drg = dr - dg;
+                    const int dbg = db - dg;
+                    if (dr >= -2 && dr <= 1 && dg >= -2 && dg <= 1 && db >= -2 && db <= 1) {
+                        out[0] = uchar(OpDiff | (dr + 2) << 4 | (dg + 2) << 2 | (db + 2));
+                        length = 1;
+                    } else if (dg >= -32 && dg <= 31 && drg >= -8 && drg <= 7 && dbg >= -8 && dbg <= 7) {
+                        out[0] = uchar(OpLuma | (dg + 32));
+                        out[1] = uchar((drg + 8) << 4 | (dbg + 8));
+                        length = 2;
+                    } else {
+                        out[0] = OpRgb;
+                        out[1] = uchar(qRed(pixel));
+                        out[2] = uchar(qGreen(pixel));
+                        out[3] = uchar(qBlue(pixel));
+                        length = 4;
+                    }
+                } else {
+                    out[0] = OpRgba;
+                    out[1] = uchar(qRed(pixel));
+                    out[2] = uchar(qGreen(pixel));
+                    out[3] = uchar(qBlue(pixel));
+                    out[4] = uchar(qAlpha(pixel));
+                    length = 5;
+                }
+                writer->commit(length);
+            }
+            previous = pixel;
+        }
+    }
+    if (run > 0)
+        writer->put(uchar(OpRun | (run - 1)));
+
+    memcpy(writer->reserve(8), kEndMarker, 8);
+    writer->commit(8);
+
+    if (!writer->flush()) {
+        if (error)
+            *error = device->errorString();
+        return false;
+    }
+    return true;
+}
+
+QImage read(QIODevice *device, QString *error)
+{
+    PROFILE_SCOPE("qoi.decode");
+    auto fail = [error](const QString &message) {
+        if (error)
+            *error = message;
+        return QImage();
+    };
+
+    uchar header[kHeaderSize];
+    if (device->read(reinterpret_cast<char *>(header), kHeaderSize) != kHeaderSize
+            || memcmp(header, kMagic, 4) != 0)
+        return fail("Not a QOI file");
+
+    const quint32 width = getBigEndian(header + 4);
+    const quint32 height = getBigEndian(header + 8);
+    const int channels = header[12];
+    if (width == 0 || height == 0 || (channels != 3 && channels != 4)
+            || qint64(width) * height > kMaxPixels)
+        return fail("Invalid QOI header");
+
+    QImage image(int(width), int(height), channels == 4 ? QImage::Format_ARGB32 : QImage::Format_RGB32);
+    if (image.isNull())
+        return fail("Out of memory");
+
+    // The stream keeps its own alpha (it feeds the index hash), but an RGB32
+    // image must hold 0xff there even if a 3-channel file says otherwise
+    const QRgb opaque = channels == 3 ? 0xff000000u : 0u;
+
+    QScopedPointer<Reader> reader(new Reader(device));
+    QRgb index[64] = {};
+    QRgb pixel = qRgba(0, 0, 0, 255);
+    int run = 0;
+    for (int y = 0; y < image.height(); ++y) {
+        QRgb *row = reinterpret_cast<QRgb *>(image.scanLine(y));
+        for (int x = 0; x < image.width(); ++x) {
+            if (run > 0) {
+                --run;
+                row[x] = pixel | opaque;
+                continue;
+            }
+
+            const uchar op = reader->get();
+            if (op == OpRgb) {
+                const uchar r = reader->get();
+                const uchar g = reader->get();
+                const uchar b = reader->get();
+                pixel = qRgba(r, g, b, qAlpha(pixel));
+            } else if (op == OpRgba) {
+                const uchar r = reader->get();
+                const uchar g = reader->get();
+                const uchar b = reader->get();
+                pixel = qRgba(r, g, b, reader->get());
+            } else if ((op & OpMask) == OpIndex) {
+                pixel = index[op];
+            } else if ((op & OpMask) == OpDiff) {
+                pixel = qRgba((qRed(pixel) + ((op >> 4) & 3) - 2) & 0xff,
+                              (qGreen(pixel) + ((op >> 2) & 3) - 2) & 0xff,
+                              (qBlue(pixel) + (op & 3) - 2) & 0xff,
+                              qAlpha(pixel));
+            } else if ((op & OpMask) == OpLuma) {
+                const uchar second = reader->get();
+                const int dg = (op & 0x3f) - 32;
+                pixel = qRgba((qRed(pixel) + dg + ((second >> 4) & 0x0f) - 8) & 0xff,
+                              (qGreen(pixel) + dg) & 0xff,
+                              (qBlue(pixel) + dg + (second & 0x0f) - 8) & 0xff,
+                              qAlpha(pixel));
+            } else {
+                run = op & 0x3f;
+            }
+
+            if (reader->atEnd())
+                return fail("Truncated QOI file");
+            index[indexOf(pixel)] = pixel;
+            row[x] = pixel | opaque;
+        }
+    }
+    return image;
+}
+
+} // namespace QoiCodec
@@ -0,0 +1,28 @@
+#ifndef QOICODEC_H
+#define QOICODEC_H
+
+#include <QImage>
+#include <QIODevice>
+#include <QString>
+
+// QOI ("Quite OK Image", qoiformat.org): lossless, single pass, no entropy
+// coder. Encodes several times faster than PNG at a somewhat larger size,
+// which makes it the format for archives and for image data the
+// application spills to disk itself.
+//
+// Both directions stream row by row over scanLine() through a small buffer;
+// neither holds an encoded copy of the whole image. Opaque images are
+// written with 3 channels, images with alpha with 4 (non-premultiplied).
+namespace QoiCodec {
+
+bool write(const QImage &image, QIODevice *device, QString *error = nullptr);
+
+// RGB32 for 3-channel files, ARGB32 for 4-channel ones; null on error
+QImage read(QIODevice *device, QString *error = nullptr);
+
+// True when 'header' starts with the QOI magic
+bool canRead(const QByteArray &header);
+
+} // namespace QoiCodec
+
+#endif // QOICODEC_H
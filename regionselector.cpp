@@ -1,25 +1,39 @@
 #include "regionselector.h"
+#include "profiler.h"
+#include "screencapture.h"
 #include <QPainter>
-#include <QScreen>
-#include <QGuiApplication>
 #include <QMouseEvent>
+#include <QPaintEvent>
+#include <QFontMetrics>
 #include <QKeyEvent>
 #include <QTimer>
 
+namespace {
+QFont sizeLabelFont()
+{
+    return QFont("Arial", 10, QFont::Bold);
+}
+
+const QColor kOverlayTint(0, 0, 0, 120);
+}
+
 RegionSelector::RegionSelector(QWidget *parent)
     : QWidget(parent),
-      isSelecting(false)
+      isSelecting(false),
+      firstPaintPending(false),
+      captureScale(1.0)
 {
+    PROFILE_SCOPE("regionSelector.construct");
     setWindowFlags(Qt::WindowStaysOnTopHint | Qt::FramelessWindowHint | Qt::Tool);
-    setAttribute(Qt::WA_TranslucentBackground);
-    setAttribute(Qt::WA_DeleteOnClose);
+    // Opaque: the capture itself is the background, no compositor needed
+    setAttribute(Qt::WA_OpaquePaintEvent);
     setCursor(Qt::CrossCursor);
+}
 
-    QScreen *screen = QGuiApplication::primaryScreen();
-    if (screen) {
-        fullScreenPixmap = screen->grabWindow(0);
-        resize(fullScreenPixmap.size());
-    }
+void RegionSelector::prepare()
+{
+    // Creates the native window now, so the first hotkey press only shows it
+    winId();
 }
 
 RegionSelector::~RegionSelector()
@@ -28,7 +42,41 @@ RegionSelector::~RegionSelector()
 
 void RegionSelector::startSelection()
 {
-    showFullScreen();
+    // Already selecting: a grab now would capture the overlay itself and
+    // dim it twice, so the current selection just continues
+    if (isVisible()) {
+        raise();
+        activateWindow();
+        return;
+    }
+
+    startTimer.start();
+    firstPaintPending = true;
+
+    // Grab before the overlay is shown, so it is not in the capture
+    fullScreenImage = ScreenCapture::grab();
+    if (fullScreenImage.isNull()) {
+        emit selectionCancelled();
+        return;
+    }
+
+    // The tint is composited once per grab into a buffer that is reused
+    // while the screen size stays the same; frames only copy pixels
+    if (dimmedImage.size() != fullScreenImage.size())
+        dimmedImage = QImage(fullScreenImage.size(), QImage::Format_RGB32);
+    QPainter painter(&dimmedImage);
+    painter.setCompositionMode(QPainter::CompositionMode_Source);
+    painter.drawImage(0, 0, fullScreenImage.image());
+    painter.setCompositionMode(QPainter::CompositionMode_SourceOver);
+    painter.fillRect(dimmedImage.rect(), kOverlayTint);
+    painter.end();
+
+    // One window over the whole virtual desktop, across all screens
+    captureScale = ScreenCapture::captureScale();
+    setGeometry(ScreenCapture::virtualGeometry());
+    show();
+    raise();
+    activateWindow();
     startPos = QPoint();
     currentPos = QPoint();
     isSelecting = false;
@@ -37,20 +85,28 @@ void RegionSelector::startSelection()
 
 void RegionSelector::paintEvent(QPaintEvent *event)
 {
-    Q_UNUSED(event)
+    PROFILE_SCOPE("regionSelector.paint");
 
     QPainter painter(this);
     painter.setRenderHint(QPainter::Antialiasing);
-    painter.drawPixmap(0, 0, fullScreenPixmap);
 
-    if (isSelecting) {
-        painter.fillRect(rect(), QColor(0, 0, 0, 120));
-        
-        QRect r = normalizedRect();
-        painter.setCompositionMode(QPainter::CompositionMode_Clear);
-        painter.fillRect(r, Qt::transparent);
-        painter.setCompositionMode(QPainter::CompositionMode_SourceOver);
+    // Each exposed rectangle is two blits: the dimmed capture, then the
+    // untouched capture inside the selection. During a drag the exposed
+    // rectangles are the strips around the old and new selection.
+    const QImage screen = fullScreenImage.image();
+    const QRect r = normalizedRect();
+    for (const QRect &exposed : event->region()) {
+        if (!isSelecting) {
+            painter.drawImage(exposed, screen, toCapture(exposed));
+            continue;
+        }
+        painter.drawImage(exposed, dimmedImage, toCapture(exposed));
+        const QRect selected = exposed.intersected(r);
+        if (!selected.isEmpty())
+            painter.drawImage(selected, screen, toCapture(selected));
+    }
 
+    if (isSelecting) {
         QPen pen(QColor(0, 162, 232), 2);
         pen.setDashPattern({5, 5});
         painter.setPen(pen);
@@ -58,9 +114,28 @@ void RegionSelector::paintEvent(QPaintEvent *event)
 
         QString sizeInfo = QString("%1 x %2").arg(r.width()).arg(r.height());
         painter.setPen(Qt::white);
-        painter.setFont(QFont("Arial", 10, QFont::Bold));
+        painter.setFont(sizeLabelFont());
         painter.drawText(r.topLeft() + QPoint(10, 20), sizeInfo);
     }
+
+    painter.end();
+    Profiler::recordPixels("regionSelector.paint", event->region());
+
+    if (firstPaintPending) {
+        firstPaintPending = false;
+        if (Profiler::isEnabled())
+            Profiler::record("regionSelector.startToFirstPaint", startTimer.nsecsElapsed());
+    }
+}
+
+// Hidden, not deleted: the window and the tint buffer are reused by the
+// next startSelection(). The grab itself is released; a finished
+// selection keeps it alive through its view only.
+void RegionSelector::dismiss()
+{
+    hide();
+    isSelecting = false;
+    fullScreenImage = ImageBuffer();
 }
 
 void RegionSelector::mousePressEvent(QMouseEvent *event)
@@ -71,7 +146,7 @@ void RegionSelector::mousePressEvent(QMouseEvent *event)
         isSelecting = true;
         update();
     } else if (event->button() == Qt::RightButton) {
-        close();
+        dismiss();
         emit selectionCancelled();
     }
 }
@@ -79,41 +154,28 @@ void RegionSelector::mousePressEvent(QMouseEvent *event)
 void RegionSelector::mouseMoveEvent(QMouseEvent *event)
 {
     if (isSelecting && event->buttons() & Qt::LeftButton) {
+        const QRect before = normalizedRect();
         currentPos = event->pos();
-        update();
+        update(selectionChange(before, normalizedRect()));
     }
 }
 
 void RegionSelector::mouseReleaseEvent(QMouseEvent *event)
 {
     if (event->button() == Qt::LeftButton && isSelecting) {
-        QRect finalRect = normalizedRect();
-        if (finalRect.width() >= 10 && finalRect.height() >= 10) {
-            capturedImage = fullScreenPixmap.copy(finalRect);
-            emit selectionFinished(capturedImage);
-        } else {
-            emit selectionCancelled();
-        }
-        close();
+        finishSelection();
     }
 }
 
 void RegionSelector::keyPressEvent(QKeyEvent *event)
 {
     if (event->key() == Qt::Key_Escape) {
-        close();
+        dismiss();
         emit selectionCancelled();
         event->accept();
     } else if (event->key() == Qt::Key_Return || event->key() == Qt::Key_Enter) {
         if (isSelecting) {
-            QRect finalRect = normalizedRect();
-            if (finalRect.width() >= 10 && finalRect.height() >= 10) {
-                capturedImage = fullScreenPixmap.copy(finalRect);
-                emit selectionFinished(capturedImage);
-            } else {
-                emit selectionCancelled();
-            }
-            close();
+            finishSelection();
         }
         event->accept();
     } else {
@@ -121,6 +183,19 @@ void RegionSelector::keyPressEvent(QKeyEvent *event)
     }
 }
 
+void RegionSelector::finishSelection()
+{
+    QRect finalRect = normalizedRect();
+    if (finalRect.width() >= 10 && finalRect.height() >= 10) {
+        // A view into the full-screen capture: no pixels are copied here
+        capturedImage = fullScreenImage.region(toCapture(finalRect));
+        emit selectionFinished(capturedImage);
+    } else {
+        emit selectionCancelled();
+    }
+    dismiss();
+}
+
 QRect RegionSelector::normalizedRect() const
 {
     int x1 = qMin(startPos.x(), currentPos.x());
@@ -129,3 +204,38 @@ QRect RegionSelector::normalizedRect() const
     int y2 = qMax(startPos.y(), currentPos.y());
     return QRect(x1, y1, x2 - x1, y2 - y1);
 }
+
+// Area covered by the size label drawn at the selection's top-left corner
+QRect RegionSelector::sizeLabelRect(const QRect &selection) const
+{
+    const QFontMetrics metrics(sizeLabelFont());
+    const QString sizeInfo = QString("%1 x %2").arg(selection.width()).arg(selection.height());
+    return metrics.boundingRect(sizeInfo).translated(selection.topLeft() + QPoint(10, 20))
+                  .adjusted(-2, -2, 2, 2);
+}
+
+// Pixels that differ between two selection states: the strips that
+// entered or left the selection, both dashed borders and both size labels.
+// A bounding union would be as large as the selection itself.
+QRegion RegionSelector::selectionChange(const QRect &before, const QRect &after) const
+{
+    auto border = [](const QRect &rect) {
+        return QRegion(rect.adjusted(-2, -2, 2, 2)) - QRegion(rect.adjusted(2, 2, -2, -2));
+    };
+    return QRegion(before).xored(QRegion(after))
+         + border(before) + border(after)
+         + sizeLabelRect(before) + sizeLabelRect(after);
+}
+
+// Widget (logical) coordinates to capture pixels; the capture is taken at
+// the highest devicePixelRatio of all screens
+QRect RegionSelector::toCapture(const QRect &rect) const
+{
+    if (captureScale == 1.0)
+        return rect;
+    const int left = qRound(rect.x() * captureScale);
+    const int top = qRound(rect.y() * captureScale);
+    return QRect(left, top,
+                 qRound((rect.x() + rect.width()) * captureScale) - left,
+                 qRound((rect.y() + rect.height()) * captureScale) - top);
+}
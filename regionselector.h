@@ -2,9 +2,12 @@
 #define REGIONSELECTOR_H
 
 #include <QWidget>
+#include <QElapsedTimer>
+#include <QImage>
 #include <QPixmap>
 #include <QPoint>
 #include <QRect>
+#include "imagebuffer.h"
 
 class RegionSelector : public QWidget
 {
@@ -14,11 +17,14 @@ public:
     explicit RegionSelector(QWidget *parent = nullptr);
     ~RegionSelector() override;
 
+    // Creates the native window ahead of the first startSelection()
+    void prepare();
+    // Grabs the screen and shows the overlay; may be called repeatedly
     void startSelection();
-    QPixmap capturedPixmap() const { return capturedImage; }
+    ImageBuffer capturedBuffer() const { return capturedImage; }
 
 signals:
-    void selectionFinished(const QPixmap &pixmap);
+    void selectionFinished(const ImageBuffer &image);
     void selectionCancelled();
 
 protected:
@@ -33,11 +39,20 @@ private:
     QPoint startPos;
     QPoint currentPos;
     bool isSelecting;
-    QPixmap fullScreenPixmap;
-    QPixmap capturedImage;
+    ImageBuffer fullScreenImage;
+    QImage dimmedImage;     // fullScreenImage under the overlay tint
+    QElapsedTimer startTimer;
+    bool firstPaintPending;
+    qreal captureScale;
+    ImageBuffer capturedImage;
 
     void drawSelectionArea(QPainter &painter);
     QRect normalizedRect() const;
+    QRect sizeLabelRect(const QRect &selection) const;
+    QRegion selectionChange(const QRect &before, const QRect &after) const;
+    void finishSelection();
+    void dismiss();
+    QRect toCapture(const QRect &rect) const;
 };
 
 #endif // REGIONSELECTOR_H
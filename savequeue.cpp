@@ -0,0 +1,101 @@
+#include "savequeue.h"
+#include "pngencoder.h"
+#include "profiler.h"
+#include "qoicodec.h"
+#include <QFileInfo>
+#include <QFutureWatcher>
+#include <QImageWriter>
+#include <QSaveFile>
+#include <QThread>
+#include <QtConcurrent>
+
+SaveQueue::SaveQueue(QObject *parent)
+    : QObject(parent),
+      pending(0)
+{
+    // A few saves can overlap without taking every core away from the rest
+    // of the application; PNG saves spread their strips over one shared pool
+    pool.setMaxThreadCount(qMax(2, QThread::idealThreadCount() / 2));
+}
+
+SaveQueue::~SaveQueue()
+{
+    // Never drop a queued screenshot on exit
+    pool.waitForDone();
+}
+
+QFuture<SaveResult> SaveQueue::enqueue(const QImage &image, const QString &path,
+                                       const QByteArray &format, int quality)
+{
+    QFuture<SaveResult> future = QtConcurrent::run(&pool, &SaveQueue::write,
+                                                   image, path, format, quality);
+
+    QFutureWatcher<SaveResult> *watcher = new QFutureWatcher<SaveResult>(this);
+    connect(watcher, &QFutureWatcher<SaveResult>::finished, this, [this, watcher]() {
+        const SaveResult result = watcher->result();
+        watcher->deleteLater();
+        --pending;
+        emit pendingCountChanged(pending);
+        emit finished(result);
+    });
+    watcher->setFuture(future);
+
+    ++pending;
+    emit pendingCountChanged(pending);
+    return future;
+}
+
+void SaveQueue::waitForAll()
+{
+    pool.waitForDone();
+}
+
+SaveResult SaveQueue::write(const QImage &image, const QString &path,
+                            const QByteArray &format, int quality)
+{
+    PROFILE_SCOPE("save.encodeAndWrite");
+    SaveResult result;
+    result.path = path;
+
+    // QSaveFile keeps a half-written file from replacing an existing one
+    QSaveFile file(path);
+    if (!file.open(QIODevice::WriteOnly)) {
+        result.error = file.errorString();
+        return result;
+    }
+
+    const QByteArray writerFormat = format.isEmpty()
+        ? QFileInfo(path).suffix().toLower().toLatin1()
+        : format;
+    if (!encode(image, &file, writerFormat, quality, &result.error)) {
+        file.cancelWriting();
+        return result;
+    }
+
+    result.bytes = file.pos();
+    result.ok = file.commit();
+    if (!result.ok)
+        result.error = file.errorString();
+    return result;
+}
+
+bool SaveQueue::encode(const QImage &image, QIODevice *device, const QByteArray &format,
+                       int quality, QString *error)
+{
+    // PNG: strips deflated on all cores; 'quality' picks the zlib level
+    if (format.toLower() == "png")
+        return PngEncoder::write(image, device, PngEncoder::levelForQuality(quality), 0, error);
+    if (format.toLower() == "qoi")
+        return QoiCodec::write(image, device, error);
+
+    QImageWriter writer(device, format);
+    if (quality >= 0)
+        writer.setQuality(quality);
+
+    if (!writer.write(image)) {
+        if (error)
+            *error = writer.errorString();
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,57 @@
+#ifndef SAVEQUEUE_H
+#define SAVEQUEUE_H
+
+#include <QObject>
+#include <QFuture>
+#include <QImage>
+#include <QIODevice>
+#include <QString>
+#include <QThreadPool>
+
+// Result of one background save
+struct SaveResult {
+    QString path;
+    qint64 bytes = 0;       // bytes written, as reported by the encoder
+    bool ok = false;
+    QString error;
+};
+
+// Encodes and writes images on worker threads so the GUI stays responsive.
+// Several saves may run at once; every enqueue() returns a QFuture and
+// finished() is emitted on the GUI thread when a save completes.
+class SaveQueue : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit SaveQueue(QObject *parent = nullptr);
+    ~SaveQueue() override;
+
+    // 'format' empty = derived from the file suffix; 'quality' -1 = default.
+    // For PNG, 'quality' selects the compression level as with QImageWriter
+    // (0 = smallest file, 100 = fastest), see PngEncoder::levelForQuality.
+    QFuture<SaveResult> enqueue(const QImage &image, const QString &path,
+                                const QByteArray &format = QByteArray(), int quality = -1);
+
+    int pendingCount() const { return pending; }
+
+    // Blocks until every queued save has been written
+    void waitForAll();
+
+    // What a queued save runs, synchronously on the calling thread
+    static SaveResult write(const QImage &image, const QString &path,
+                            const QByteArray &format, int quality);
+    // Encodes into an open device, e.g. stdout; 'format' must not be empty
+    static bool encode(const QImage &image, QIODevice *device, const QByteArray &format,
+                       int quality, QString *error = nullptr);
+
+signals:
+    void pendingCountChanged(int count);
+    void finished(const SaveResult &result);
+
+private:
+    QThreadPool pool;
+    int pending;
+};
+
+#endif // SAVEQUEUE_H
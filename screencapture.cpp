@@ -0,0 +1,219 @@
+#include "screencapture.h"
+#include "capturesource.h"
+#include "profiler.h"
+#ifdef HAVE_XSHM
+#include "xshmcapturesource.h"
+#endif
+#include <QGuiApplication>
+#include <QScopedPointer>
+#include <QtConcurrent>
+#include <QtDebug>
+#include <cmath>
+
+namespace {
+
+CaptureSource *activeSource = nullptr;
+
+// One screen's share of a capture
+struct ScreenJob {
+    int index;
+    QRect local;        // logical, relative to the screen
+    QRect destination;  // device pixels in the output image
+    QImage pixels;      // pre-grabbed for sources that are not thread-safe
+};
+
+// Logical rectangle to device pixels; shared edges of neighbouring screens
+// round to the same column or row
+QRect toDevice(const QRect &logical, qreal scale)
+{
+    const int left = qRound(logical.x() * scale);
+    const int top = qRound(logical.y() * scale);
+    const int right = qRound((logical.x() + logical.width()) * scale);
+    const int bottom = qRound((logical.y() + logical.height()) * scale);
+    return QRect(left, top, right - left, bottom - top);
+}
+
+void place(const ScreenJob &job, QImage pixels, uchar *bits, int bytesPerLine)
+{
+    if (pixels.isNull() || job.destination.isEmpty())
+        return;
+    if (pixels.format() != QImage::Format_RGB32)
+        pixels = pixels.convertToFormat(QImage::Format_RGB32);
+    if (pixels.size() != job.destination.size())
+        pixels = pixels.scaled(job.destination.size(), Qt::IgnoreAspectRatio, Qt::SmoothTransformation);
+
+    const int rowBytes = job.destination.width() * 4;
+    for (int y = 0; y < job.destination.height(); ++y) {
+        memcpy(bits + qptrdiff(job.destination.y() + y) * bytesPerLine + job.destination.x() * 4,
+               pixels.constScanLine(y), size_t(rowBytes));
+    }
+}
+
+// Composites 'area' into 'output'. With 'reuse', an existing RGB32 buffer
+// of the right size is written in place; otherwise 'output' may become the
+// source's own image (single screen at native size) or a new buffer.
+bool grabImpl(const QRect &area, QImage &output, bool reuse)
+{
+    PROFILE_SCOPE("capture.grab");
+    CaptureSource *capture = source();
+    const QVector<CaptureSource::Screen> screens = capture->screens();
+
+    QRect desktop;
+    qreal scale = 1.0;
+    for (const CaptureSource::Screen &screen : screens) {
+        desktop |= screen.geometry;
+        scale = qMax(scale, screen.devicePixelRatio);
+    }
+    const QRect target = area.isNull() ? desktop : area.intersected(desktop);
+    if (target.isEmpty())
+        return false;
+
+    QVector<ScreenJob> jobs;
+    qint64 coveredArea = 0;
+    for (int i = 0; i < screens.size(); ++i) {
+        const QRect part = screens.at(i).geometry.intersected(target);
+        if (part.isEmpty())
+            continue;
+        ScreenJob job;
+        job.index = i;
+        job.local = part.translated(-screens.at(i).geometry.topLeft());
+        job.destination = toDevice(part.translated(-target.topLeft()), scale);
+        jobs.append(job);
+        coveredArea += qint64(part.width()) * part.height();
+    }
+    if (jobs.isEmpty())
+        return false;
+
+    if (!capture->isThreadSafe()) {
+        for (ScreenJob &job : jobs)
+            job.pixels = capture->grabScreen(job.index, job.local);
+    }
+
+    // One screen at native resolution: the grab is the result
+    const QSize outputSize = toDevice(QRect(QPoint(0, 0), target.size()), scale).size();
+    if (jobs.size() == 1) {
+        QImage pixels = jobs.first().pixels.isNull()
+            ? capture->grabScreen(jobs.first().index, jobs.first().local)
+            : jobs.first().pixels;
+        if (pixels.size() == outputSize && coveredArea == qint64(target.width()) * target.height()
+                && !reuse) {
+            output = pixels;
+            return true;
+        }
+        jobs.first().pixels = pixels;
+    }
+
+    if (!reuse || output.size() != outputSize || output.format() != QImage::Format_RGB32) {
+        // A null image means the allocation failed; 'output' stays as it was
+        QImage allocated(outputSize, QImage::Format_RGB32);
+        if (allocated.isNull()) {
+            qWarning() << "Capture: cannot allocate" << outputSize;
+            return false;
+        }
+        output = allocated;
+    }
+    if (coveredArea < qint64(target.width()) * target.height())
+        output.fill(Qt::black);
+
+    // Screens write disjoint rectangles of the shared output buffer
+    uchar *bits = output.bits();
+    const int bytesPerLine = output.bytesPerLine();
+    QtConcurrent::blockingMap(jobs, [capture, bits, bytesPerLine](ScreenJob &job) {
+        const QImage pixels = job.pixels.isNull() ? capture->grabScreen(job.index, job.local)
+                                                  : job.pixels;
+        place(job, pixels, bits, bytesPerLine);
+        job.pixels = QImage();
+    });
+    return true;
+}
+
+} // namespace
+
+namespace ScreenCapture {
+
+QStringList backendNames()
+{
+    QStringList names;
+    names << "qt" << "synthetic";
+#ifdef HAVE_XSHM
+    names << "xshm";
+#endif
+    return names;
+}
+
+CaptureSource *createSource(const QString &backend)
+{
+    if (backend == "qt")
+        return new QtCaptureSource;
+    if (backend == "synthetic") {
+        const QString spec = QString::fromLocal8Bit(qgetenv("SCREENSHOTTOOL_SYNTHETIC_SCREENS"));
+        const QVector<CaptureSource::Screen> screens =
+            SyntheticCaptureSource::parseScreens(spec.isEmpty() ? QString("1920x1080") : spec);
+        return screens.isEmpty() ? nullptr : new SyntheticCaptureSource(screens);
+    }
+#ifdef HAVE_XSHM
+    if (backend == "xshm") {
+        QScopedPointer<XShmCaptureSource> xshm(new XShmCaptureSource);
+        return xshm->isValid() ? xshm.take() : nullptr;
+    }
+#endif
+    return nullptr;
+}
+
+CaptureSource *source()
+{
+    static QScopedPointer<CaptureSource> defaultSource;
+    if (activeSource)
+        return activeSource;
+    if (defaultSource.isNull()) {
+        QString backend = QString::fromLocal8Bit(qgetenv("SCREENSHOTTOOL_CAPTURE_BACKEND"));
+        const bool requested = !backend.isEmpty();
+#ifdef HAVE_XSHM
+        // Implicit on X11; without the extension it quietly falls back to qt
+        if (!requested && QGuiApplication::platformName() == "xcb")
+            backend = "xshm";
+#endif
+        if (!backend.isEmpty() && backend != "qt") {
+            defaultSource.reset(createSource(backend));
+            if (defaultSource.isNull() && requested)
+                qWarning() << "Capture backend" << backend << "is not available, using qt";
+        }
+        if (defaultSource.isNull())
+            defaultSource.reset(new QtCaptureSource);
+    }
+    return defaultSource.data();
+}
+
+void setSource(CaptureSource *source)
+{
+    activeSource = source;
+}
+
+QRect virtualGeometry()
+{
+    QRect desktop;
+    for (const CaptureSource::Screen &screen : source()->screens())
+        desktop |= screen.geometry;
+    return desktop;
+}
+
+qreal captureScale()
+{
+    qreal scale = 1.0;
+    for (const CaptureSource::Screen &screen : source()->screens())
+        scale = qMax(scale, screen.devicePixelRatio);
+    return scale;
+}
+
+ImageBuffer grab(const QRect &area)
+{
+    QImage output;
+    return grabImpl(area, output, false) ? ImageBuffer(output) : ImageBuffer();
+}
+
+bool grabInto(QImage &target, const QRect &area)
+{
+    return grabImpl(area, target, true);
+}
+
+} // namespace ScreenCapture
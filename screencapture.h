@@ -0,0 +1,50 @@
+#ifndef SCREENCAPTURE_H
+#define SCREENCAPTURE_H
+
+#include <QRect>
+#include <QStringList>
+#include "imagebuffer.h"
+
+class CaptureSource;
+
+// Screen grabbing shared by the main window, RegionSelector and the
+// command-line mode. Needs a QGuiApplication, not a QApplication.
+//
+// A capture covers the virtual desktop: every screen of the active
+// CaptureSource is grabbed and composited at its place, at the highest
+// devicePixelRatio among the screens. Screens with a lower ratio are
+// scaled up; areas between screens are black.
+namespace ScreenCapture {
+
+// Backends for createSource(): "qt", "synthetic", and "xshm" in X11 builds
+QStringList backendNames();
+// New source owned by the caller; nullptr when the backend is unknown or
+// cannot run here (e.g. "xshm" without an X server)
+CaptureSource *createSource(const QString &backend);
+
+// Active source. Unless setSource() was called, the backend named by
+// SCREENSHOTTOOL_CAPTURE_BACKEND; without it "xshm" on X11 and "qt"
+// everywhere else.
+CaptureSource *source();
+// Does not take ownership; nullptr restores the default source
+void setSource(CaptureSource *source);
+
+// Union of all screen geometries, in logical pixels
+QRect virtualGeometry();
+// Device pixels per logical pixel of grab() results
+qreal captureScale();
+
+// Grabs 'area' of the virtual desktop (logical pixels; null = everything).
+// Screens are converted and composited concurrently. Returns a null
+// buffer when there is no screen or 'area' misses all of them.
+ImageBuffer grab(const QRect &area = QRect());
+
+// Same capture, written into 'target'. When 'target' already is an
+// unshared RGB32 image of the capture's size no buffer is allocated, which
+// lets repeated captures reuse their memory; otherwise it is reallocated.
+// Returns false, leaving 'target' untouched, when grab() would be null.
+bool grabInto(QImage &target, const QRect &area = QRect());
+
+} // namespace ScreenCapture
+
+#endif // SCREENCAPTURE_H
@@ -2,6 +2,13 @@
 #include "regionselector.h"
 #include "imageeditor.h"
 #include "themes.h"
+#include "profiler.h"
+#include "screencapture.h"
+#include "burstpicker.h"
+#include "historystore.h"
+#include "historygallery.h"
+#include "perceptualhash.h"
+#include "clipboarddata.h"
 #include <QToolBar>
 #include <QPushButton>
 #include <QVBoxLayout>
@@ -13,19 +20,32 @@
 #include <QMessageBox>
 #include <QDateTime>
 #include <QShortcut>
-#include <QFile>  // Для определения размера файла
+#include <QFileInfo>
+#include <QProgressBar>
+#include <QSpinBox>
+#include <QCheckBox>
 #include <QStackedWidget>
+#include <QWindow>
+#include <QtDebug>
+
+namespace {
+// Full-screen captures kept in the session history; beyond this the oldest
+// keyframe and its deltas are dropped
+const int kHistoryLimit = 200;
+}
 
 ScreenshotTool::ScreenshotTool(QWidget *parent)
     : QMainWindow(parent),
+      historyIndex(-1),
+      historyStore(nullptr),
       regionSelector(nullptr),
-      imageEditor(nullptr)
+      imageEditor(nullptr),
+      initialCapturePending(true),
+      exitAfterFirstPreview(false)
 {
     setupUI();
     setupShortcuts();
     applyTheme(Themes::Light);
-
-    QTimer::singleShot(500, this, &ScreenshotTool::onFullScreenshot);
 }
 
 ScreenshotTool::~ScreenshotTool()
@@ -66,6 +86,9 @@ void ScreenshotTool::setupUI()
                           "Горячие клавиши:<br>"
                           "Ctrl+Shift+S — весь экран<br>"
                           "Ctrl+Shift+A — выделить область<br>"
+                          "Ctrl+Shift+B — серия кадров<br>"
+                          "Alt+←/→ — предыдущие снимки<br>"
+                          "Ctrl+H — архив снимков<br>"
                           "Ctrl+S — сохранить<br>"
                           "Ctrl+C — копировать"
                           "</span>"
@@ -74,13 +97,8 @@ void ScreenshotTool::setupUI()
 
     previewWidget->setLayout(previewLayout);
     
-    // Create image editor
-    imageEditor = new ImageEditor(this);
-    connect(imageEditor, &ImageEditor::imageEdited, this, &ScreenshotTool::onImageEdited);
-    
-    // Add widgets to stacked widget
+    // The image editor is created on first use (ensureImageEditor)
     stackedWidget->addWidget(previewWidget);
-    stackedWidget->addWidget(imageEditor);
     stackedWidget->setCurrentIndex(0); // Show preview initially
     
     setCentralWidget(stackedWidget);
@@ -101,6 +119,54 @@ void ScreenshotTool::setupUI()
     connect(regionButton, &QPushButton::clicked, this, &ScreenshotTool::onRegionScreenshot);
     toolBar->addWidget(regionButton);
 
+    // Burst: N frames at a fixed rate, then pick one (BurstPicker)
+    burstCapture = new BurstCapture(this);
+    // Queued: the picker dialog must not run inside the capture timer's slot
+    connect(burstCapture, &BurstCapture::finished, this, &ScreenshotTool::onBurstFinished,
+            Qt::QueuedConnection);
+    connect(burstCapture, &BurstCapture::frameCaptured, this, [this](int count) {
+        QString message = QString("Серия: кадр %1 из %2").arg(count).arg(burstFramesSpin->value());
+        // The ring is capped by bytes; a long burst keeps its latest frames
+        if (burstCapture->capacity() < burstFramesSpin->value())
+            message += QString(" • в памяти последние %1").arg(burstCapture->capacity());
+        statusBar()->showMessage(message);
+    });
+
+    burstButton = new QPushButton("🎞️ Серия", this);
+    burstButton->setToolTip("Ctrl+Shift+B");
+    connect(burstButton, &QPushButton::clicked, this, &ScreenshotTool::onBurst);
+    toolBar->addWidget(burstButton);
+
+    burstFramesSpin = new QSpinBox(this);
+    burstFramesSpin->setRange(2, 240);
+    burstFramesSpin->setValue(20);
+    burstFramesSpin->setSuffix(" кадр.");
+    burstFramesSpin->setToolTip("Число кадров серии (память: кадры × размер экрана, не больше 1 ГБ)");
+    toolBar->addWidget(burstFramesSpin);
+
+    burstRateSpin = new QSpinBox(this);
+    burstRateSpin->setRange(1, 60);
+    burstRateSpin->setValue(10);
+    burstRateSpin->setSuffix(" к/с");
+    burstRateSpin->setToolTip("Частота кадров серии");
+    toolBar->addWidget(burstRateSpin);
+
+    // Archive: every capture on disk; opening reads only the index
+    historyStore = new HistoryStore(HistoryStore::defaultDirectory(), this);
+    if (!historyStore->isOpen())
+        qWarning() << "History store unavailable:" << historyStore->errorString();
+
+    QPushButton *archiveButton = new QPushButton("🗂️ Архив", this);
+    archiveButton->setToolTip("Ctrl+H");
+    connect(archiveButton, &QPushButton::clicked, this, &ScreenshotTool::onHistoryGallery);
+    toolBar->addWidget(archiveButton);
+
+    // Repeated Ctrl+Shift+S on an unchanged screen: near-duplicates are
+    // always reported, and kept out of the archive when this is checked
+    skipDuplicatesCheck = new QCheckBox("Без дубликатов", this);
+    skipDuplicatesCheck->setToolTip("Не добавлять в архив снимки, почти не отличающиеся от уже сохранённых");
+    toolBar->addWidget(skipDuplicatesCheck);
+
     // Add edit button
     editButton = new QPushButton("✏️ Редактировать", this);
     editButton->setToolTip("Ctrl+E");
@@ -132,9 +198,82 @@ void ScreenshotTool::setupUI()
     toolBar->addWidget(new QLabel(" Тема: ", this));
     toolBar->addWidget(themeComboBox);
 
+    // Background saves: busy indicator while the queue is not empty
+    saveQueue = new SaveQueue(this);
+    connect(saveQueue, &SaveQueue::finished, this, &ScreenshotTool::onSaveFinished);
+    connect(saveQueue, &SaveQueue::pendingCountChanged, this, &ScreenshotTool::onSavePendingChanged);
+
+    saveProgress = new QProgressBar(this);
+    saveProgress->setRange(0, 0);
+    saveProgress->setMaximumWidth(160);
+    saveProgress->setTextVisible(true);
+    saveProgress->hide();
+    statusBar()->addPermanentWidget(saveProgress);
+    
+    // Profiling HUD (SCREENSHOTTOOL_PROFILE=1): p50/p99 of the slowest timers
+    profileLabel = nullptr;
+    if (Profiler::isEnabled()) {
+        profileLabel = new QLabel(this);
+        statusBar()->addPermanentWidget(profileLabel);
+        QTimer *profileTimer = new QTimer(this);
+        connect(profileTimer, &QTimer::timeout, this, [this]() {
+            profileLabel->setText(Profiler::summary());
+        });
+        profileTimer->start(1000);
+    }
+
     statusBar()->showMessage("Готово • Горячие клавиши: Ctrl+Shift+S/A, Ctrl+S/C");
 }
 
+// Most sessions never edit, so the editor and its toolbar are built the
+// first time they are needed
+void ScreenshotTool::ensureImageEditor()
+{
+    if (imageEditor)
+        return;
+    
+    imageEditor = new ImageEditor(this);
+    connect(imageEditor, &ImageEditor::imageEdited, this, &ScreenshotTool::onImageEdited);
+    stackedWidget->addWidget(imageEditor);
+}
+
+void ScreenshotTool::setExitAfterFirstPreview(bool exit)
+{
+    exitAfterFirstPreview = exit;
+    if (exit)
+        previewLabel->installEventFilter(this);
+    else
+        previewLabel->removeEventFilter(this);
+}
+
+void ScreenshotTool::showEvent(QShowEvent *event)
+{
+    QMainWindow::showEvent(event);
+    
+    // The first capture waits for the window to be exposed (see eventFilter)
+    // instead of a fixed delay. The native window exists now.
+    if (initialCapturePending && windowHandle())
+        windowHandle()->installEventFilter(this);
+}
+
+bool ScreenshotTool::eventFilter(QObject *watched, QEvent *event)
+{
+    if (initialCapturePending && watched == windowHandle()
+            && event->type() == QEvent::Expose && windowHandle()->isExposed()) {
+        initialCapturePending = false;
+        windowHandle()->removeEventFilter(this);
+        // Queued so that the exposed window finishes its first paint;
+        // the region overlay is pre-warmed right after the first capture
+        QMetaObject::invokeMethod(this, "onFullScreenshot", Qt::QueuedConnection);
+        QTimer::singleShot(0, this, &ScreenshotTool::ensureRegionSelector);
+    } else if (exitAfterFirstPreview && watched == previewLabel
+               && event->type() == QEvent::Paint && previewLabel->pixmap()) {
+        // Startup benchmark: the first preview is about to be on screen
+        QMetaObject::invokeMethod(qApp, "quit", Qt::QueuedConnection);
+    }
+    return QMainWindow::eventFilter(watched, event);
+}
+
 void ScreenshotTool::setupShortcuts()
 {
     // Ctrl+Shift+S — весь экран
@@ -147,6 +286,24 @@ void ScreenshotTool::setupShortcuts()
     connect(shortcutRegion, &QShortcut::activated, this, &ScreenshotTool::onRegionScreenshot);
     shortcuts.append(shortcutRegion);
 
+    // Ctrl+Shift+B — серия кадров (повторное нажатие останавливает)
+    QShortcut *shortcutBurst = new QShortcut(QKeySequence(Qt::CTRL + Qt::SHIFT + Qt::Key_B), this);
+    connect(shortcutBurst, &QShortcut::activated, this, &ScreenshotTool::onBurst);
+    shortcuts.append(shortcutBurst);
+
+    // Alt+Left / Alt+Right — предыдущие/следующие снимки экрана
+    QShortcut *shortcutBack = new QShortcut(QKeySequence(Qt::ALT + Qt::Key_Left), this);
+    connect(shortcutBack, &QShortcut::activated, this, &ScreenshotTool::onHistoryBack);
+    shortcuts.append(shortcutBack);
+    QShortcut *shortcutForward = new QShortcut(QKeySequence(Qt::ALT + Qt::Key_Right), this);
+    connect(shortcutForward, &QShortcut::activated, this, &ScreenshotTool::onHistoryForward);
+    shortcuts.append(shortcutForward);
+
+    // Ctrl+H — архив снимков
+    QShortcut *shortcutArchive = new QShortcut(QKeySequence(Qt::CTRL + Qt::Key_H), this);
+    connect(shortcutArchive, &QShortcut::activated, this, &ScreenshotTool::onHistoryGallery);
+    shortcuts.append(shortcutArchive);
+
     // Ctrl+E — редактировать
     QShortcut *shortcutEdit = new QShortcut(QKeySequence(Qt::CTRL + Qt::Key_E), this);
     connect(shortcutEdit, &QShortcut::activated, this, &ScreenshotTool::onEdit);
@@ -161,6 +318,24 @@ void ScreenshotTool::setupShortcuts()
     QShortcut *shortcutCopy = new QShortcut(QKeySequence(Qt::CTRL + Qt::Key_C), this);
     connect(shortcutCopy, &QShortcut::activated, this, &ScreenshotTool::onCopy);
     shortcuts.append(shortcutCopy);
+
+    // Ctrl+Shift+P — выгрузить статистику профилирования в JSON
+    QShortcut *shortcutProfile = new QShortcut(QKeySequence(Qt::CTRL + Qt::SHIFT + Qt::Key_P), this);
+    connect(shortcutProfile, &QShortcut::activated, this, &ScreenshotTool::onDumpProfile);
+    shortcuts.append(shortcutProfile);
+}
+
+void ScreenshotTool::onDumpProfile()
+{
+    if (!Profiler::isEnabled()) {
+        statusBar()->showMessage("Профилирование выключено • SCREENSHOTTOOL_PROFILE=1", 3000);
+        return;
+    }
+    const QString path = Profiler::defaultDumpPath();
+    if (Profiler::dumpJson(path))
+        statusBar()->showMessage(QString("Статистика сохранена: %1").arg(path), 3000);
+    else
+        statusBar()->showMessage(QString("Не удалось записать %1").arg(path), 5000);
 }
 
 void ScreenshotTool::applyTheme(const QString &theme)
@@ -190,51 +365,194 @@ void ScreenshotTool::onThemeChanged(int index)
     statusBar()->showMessage(QString("Тема: %1 • Горячие клавиши активны").arg(themeComboBox->currentText()));
 }
 
-QPixmap ScreenshotTool::captureFullScreen()
+ImageBuffer ScreenshotTool::captureFullScreen()
 {
-    QScreen *screen = QGuiApplication::primaryScreen();
-    if (!screen) return QPixmap();
-    return screen->grabWindow(0);
+    PROFILE_SCOPE("capture.fullScreen");
+    return ScreenCapture::grab();
 }
 
 void ScreenshotTool::onFullScreenshot()
 {
     currentScreenshot = captureFullScreen();
     if (!currentScreenshot.isNull()) {
+        // Consecutive captures of the desktop share most tiles; the history
+        // keeps only the changed ones (CaptureStore)
+        while (captureHistory.count() >= kHistoryLimit)
+            historyIndex = qMax(-1, historyIndex - captureHistory.dropOldestKeyframe());
+        historyIndex = captureHistory.append(currentScreenshot.image());
         setPreviewPixmap(currentScreenshot);
+        const QString archiveNote = archiveCapture();
         editButton->setEnabled(true); // Enable edit button
         statusBar()->showMessage(QString("Скриншот всего экрана: %1x%2 • Ctrl+S — сохранить")
             .arg(currentScreenshot.width())
-            .arg(currentScreenshot.height()));
+            .arg(currentScreenshot.height()) + archiveNote);
     } else {
+        previewPyramid.clear();
+        stackedWidget->setCurrentIndex(0);
         previewLabel->setText("<div style='color: #f44336; padding: 20px;'>Ошибка захвата экрана</div>");
         statusBar()->showMessage("Не удалось сделать скриншот", 5000);
     }
 }
 
-void ScreenshotTool::onRegionScreenshot()
+void ScreenshotTool::onBurst()
+{
+    if (burstCapture->isRunning()) {
+        burstCapture->stop();
+        return;
+    }
+    const int frames = burstFramesSpin->value();
+    if (!burstCapture->start(frames, burstRateSpin->value(), frames)) {
+        statusBar()->showMessage("Недостаточно памяти для серии", 5000);
+        return;
+    }
+    burstButton->setText("⏹️ Стоп");
+}
+
+void ScreenshotTool::onBurstFinished(const BurstCapture::Stats &stats)
 {
-    if (!regionSelector) {
-        regionSelector = new RegionSelector();
-        connect(regionSelector, &RegionSelector::selectionFinished,
-                this, &ScreenshotTool::onRegionSelected);
-        connect(regionSelector, &RegionSelector::selectionCancelled,
-                this, &ScreenshotTool::onRegionCancelled);
-        connect(regionSelector, &QObject::destroyed,
-                [this]() { regionSelector = nullptr; });
+    burstButton->setText("🎞️ Серия");
+    if (burstCapture->frameCount() == 0) {
+        burstCapture->release();
+        statusBar()->showMessage("Не удалось снять серию", 5000);
+        return;
     }
+
+    const QString summary = QString("Серия: %1 кадров, %2 к/с, пропущено %3")
+        .arg(stats.captured)
+        .arg(stats.framesPerSecond, 0, 'f', 1)
+        .arg(stats.dropped);
+    statusBar()->showMessage(summary);
+
+    BurstPicker picker(burstCapture, this);
+    const bool accepted = picker.exec() == QDialog::Accepted;
+    const int index = picker.selectedFrame();
+    // The chosen frame keeps its buffer (implicitly shared); the rest of
+    // the ring is freed instead of staying allocated until the next burst
+    if (accepted)
+        currentScreenshot = burstCapture->frame(index);
+    burstCapture->release();
+    if (!accepted)
+        return;
+
+    setPreviewPixmap(currentScreenshot);
+    const QString archiveNote = archiveCapture();
+    editButton->setEnabled(true);
+    statusBar()->showMessage(QString("Кадр %1 из серии • %2 • Ctrl+S — сохранить")
+        .arg(index + 1).arg(summary) + archiveNote);
+}
+
+void ScreenshotTool::onHistoryBack()
+{
+    showHistoryFrame(historyIndex - 1);
+}
+
+void ScreenshotTool::onHistoryForward()
+{
+    showHistoryFrame(historyIndex + 1);
+}
+
+void ScreenshotTool::showHistoryFrame(int index)
+{
+    if (index < 0 || index >= captureHistory.count())
+        return;
+    historyIndex = index;
+    currentScreenshot = ImageBuffer(captureHistory.frame(index));
+    setPreviewPixmap(currentScreenshot);
+    editButton->setEnabled(true);
+
+    const CaptureStore::Stats stats = captureHistory.stats();
+    statusBar()->showMessage(QString("Снимок %1 из %2 • история: %3 МБ, сжатие ×%4 • сборка кадра %5 мс")
+        .arg(index + 1).arg(stats.frames)
+        .arg(stats.storedBytes / (1024 * 1024))
+        .arg(stats.compressionRatio, 0, 'f', 1)
+        .arg(stats.lastRebuildNs / 1000000.0, 0, 'f', 1));
+}
+
+// After setPreviewPixmap: the thumbnail comes from the preview pyramid, and
+// the image is written on the store's worker thread. Returns a note for the
+// status bar when the capture nearly matches an archived one.
+QString ScreenshotTool::archiveCapture()
+{
+    if (!historyStore->isOpen())
+        return QString();
+
+    const quint64 hash = PerceptualHash::compute(currentScreenshot.image());
+    const DuplicateIndex::Match match = historyStore->findDuplicate(hash, currentScreenshot.size());
+    QString note;
+    if (match.id != 0) {
+        const HistoryStore::Entry &original = historyStore->entry(historyStore->indexOf(match.id));
+        note = QString(" • почти как снимок от %1").arg(original.time.toString("dd.MM hh:mm:ss"));
+        if (skipDuplicatesCheck->isChecked())
+            return note + ", в архив не добавлен";
+    }
+
+    historyStore->append(currentScreenshot.image(), hash, previewPyramid.scaled(
+        QSize(HistoryStore::ThumbnailWidth, HistoryStore::ThumbnailHeight)));
+    return note;
+}
+
+void ScreenshotTool::onHistoryGallery()
+{
+    if (!historyStore->isOpen()) {
+        QMessageBox::warning(this, "Архив", QString("Архив снимков недоступен\n%1")
+            .arg(historyStore->errorString()));
+        return;
+    }
+
+    HistoryGallery gallery(historyStore, this);
+    if (gallery.exec() != QDialog::Accepted || gallery.selectedId() == 0)
+        return;
+
+    // The full image is decoded only now
+    const quint64 id = gallery.selectedId();
+    QString error;
+    const QImage image = historyStore->load(id, &error);
+    if (image.isNull()) {
+        QMessageBox::warning(this, "Архив", QString("Не удалось открыть снимок\n%1").arg(error));
+        return;
+    }
+    currentScreenshot = ImageBuffer(image);
+    setPreviewPixmap(currentScreenshot);
+    editButton->setEnabled(true);
+    const HistoryStore::Entry &entry = historyStore->entry(historyStore->indexOf(id));
+    statusBar()->showMessage(QString("Снимок из архива: %1 • %2x%3 • Ctrl+S — сохранить")
+        .arg(entry.time.toString("dd.MM.yyyy hh:mm:ss"))
+        .arg(image.width()).arg(image.height()));
+}
+
+// The overlay lives for the whole session; it is hidden between selections
+void ScreenshotTool::ensureRegionSelector()
+{
+    if (regionSelector)
+        return;
+    
+    regionSelector = new RegionSelector();
+    connect(regionSelector, &RegionSelector::selectionFinished,
+            this, &ScreenshotTool::onRegionSelected);
+    connect(regionSelector, &RegionSelector::selectionCancelled,
+            this, &ScreenshotTool::onRegionCancelled);
+    connect(regionSelector, &QObject::destroyed,
+            [this]() { regionSelector = nullptr; });
+    regionSelector->prepare();
+}
+
+void ScreenshotTool::onRegionScreenshot()
+{
+    PROFILE_SCOPE("regionSelector.hotkey");
+    ensureRegionSelector();
     statusBar()->showMessage("Выделите область мышью • Esc — отмена");
     regionSelector->startSelection();
 }
 
-void ScreenshotTool::onRegionSelected(const QPixmap &pixmap)
+void ScreenshotTool::onRegionSelected(const ImageBuffer &image)
 {
-    currentScreenshot = pixmap;
+    currentScreenshot = image;
     setPreviewPixmap(currentScreenshot);
+    const QString archiveNote = archiveCapture();
     editButton->setEnabled(true); // Enable edit button
     statusBar()->showMessage(QString("Выделенная область: %1x%2 • Ctrl+S — сохранить")
         .arg(currentScreenshot.width())
-        .arg(currentScreenshot.height()));
+        .arg(currentScreenshot.height()) + archiveNote);
 }
 
 void ScreenshotTool::onRegionCancelled()
@@ -250,42 +568,66 @@ void ScreenshotTool::onEdit()
     }
     
     // Set the image in the editor
+    ensureImageEditor();
     imageEditor->setImage(currentScreenshot);
     
     // Switch to the editor view
-    stackedWidget->setCurrentIndex(1);
+    stackedWidget->setCurrentWidget(imageEditor);
     
     // Update status bar
     statusBar()->showMessage("Режим редактирования • Используйте инструменты для изменения изображения");
 }
 
-void ScreenshotTool::onImageEdited(const QPixmap &editedImage)
+void ScreenshotTool::onImageEdited(const ImageBuffer &editedImage)
 {
     // Update the current screenshot with the edited version
     currentScreenshot = editedImage;
     
-    // Switch back to preview view
-    stackedWidget->setCurrentIndex(0);
-    
-    // Update the preview
+    // Switch back to preview view with the edited image
     setPreviewPixmap(currentScreenshot);
     
     statusBar()->showMessage("Изображение отредактировано • Ctrl+S — сохранить");
 }
 
-void ScreenshotTool::setPreviewPixmap(const QPixmap &pixmap)
+// While the editor is open its annotations are still vectors; flatten them
+// into the screenshot before it leaves the application
+void ScreenshotTool::takeEditorImage()
 {
-    QPixmap preview = pixmap.scaled(
-        previewLabel->size() * 0.9,
-        Qt::KeepAspectRatio,
-        Qt::SmoothTransformation
-    );
-    previewLabel->setPixmap(preview);
+    if (stackedWidget->currentWidget() == imageEditor)
+        currentScreenshot = imageEditor->exportImage();
+}
+
+// Called with a new capture or an edited image; builds its pyramid once.
+// The new image leaves the editor: takeEditorImage() must not replace it
+// with the image the editor was opened on.
+void ScreenshotTool::setPreviewPixmap(const ImageBuffer &image)
+{
+    PROFILE_SCOPE("preview.set");
+    stackedWidget->setCurrentIndex(0);
+    previewPyramid.setImage(image);
+    refreshPreview();
+}
+
+// Rescales the preview from the cached pyramid, e.g. after a resize
+void ScreenshotTool::refreshPreview()
+{
+    if (previewPyramid.isNull())
+        return;
+    
+    QImage preview = previewPyramid.scaled(previewLabel->size() * 0.9, Qt::KeepAspectRatio);
+    previewLabel->setPixmap(QPixmap::fromImage(preview));
     previewLabel->setText("");
 }
 
+void ScreenshotTool::resizeEvent(QResizeEvent *event)
+{
+    QMainWindow::resizeEvent(event);
+    refreshPreview();
+}
+
 void ScreenshotTool::onSave()
 {
+    takeEditorImage();
     if (currentScreenshot.isNull()) {
         QMessageBox::warning(this, "Ошибка", "Нет скриншота для сохранения");
         return;
@@ -294,33 +636,66 @@ void ScreenshotTool::onSave()
     QString defaultName = QString("screenshot_%1.png")
         .arg(QDateTime::currentDateTime().toString("yyyyMMdd_hhmmss"));
     
+    // The PNG entries choose the compression level, from fastest to smallest
+    const QString pngFastest = "PNG — быстрее (*.png)";
+    const QString pngBalanced = "PNG Изображение (*.png)";
+    const QString pngSmallest = "PNG — меньше размер (*.png)";
+    const QString jpeg = "JPEG Изображение (*.jpg)";
+    const QString qoi = "QOI — быстро, без потерь (*.qoi)";
+    const QStringList filters = { pngFastest, pngBalanced, pngSmallest, jpeg, qoi };
+
+    QString selectedFilter = filters.contains(lastSaveFilter) ? lastSaveFilter : pngBalanced;
     QString path = QFileDialog::getSaveFileName(
         this,
         "Сохранить скриншот",
         defaultName,
-        "PNG Изображение (*.png);;JPEG Изображение (*.jpg)"
+        filters.join(";;"),
+        &selectedFilter
     );
 
     if (!path.isEmpty()) {
-        if (currentScreenshot.save(path)) {
-            qint64 sizeKb = QFile(path).size() / 1024;
-            statusBar()->showMessage(QString("Сохранено: %1 • Размер: %2 КБ")
-                .arg(path)
-                .arg(sizeKb), 3000);
-        } else {
-            QMessageBox::critical(this, "Ошибка", "Не удалось сохранить файл");
-        }
+        lastSaveFilter = selectedFilter;
+        // Encoding and writing happen on the save queue; hotkeys keep working
+        if (QFileInfo(path).suffix().isEmpty())
+            path += selectedFilter == jpeg ? ".jpg" : selectedFilter == qoi ? ".qoi" : ".png";
+        // PNG quality as in QImageWriter: 0 = smallest file, 80 = zlib level 1
+        int quality = -1;
+        if (QFileInfo(path).suffix().toLower() == "png")
+            quality = selectedFilter == pngFastest ? 80 : selectedFilter == pngSmallest ? 0 : -1;
+        saveQueue->enqueue(currentScreenshot.image(), path, QByteArray(), quality);
+        statusBar()->showMessage(QString("Сохранение: %1…").arg(path));
     }
 }
 
+void ScreenshotTool::onSaveFinished(const SaveResult &result)
+{
+    if (result.ok) {
+        statusBar()->showMessage(QString("Сохранено: %1 • Размер: %2 КБ")
+            .arg(result.path)
+            .arg(result.bytes / 1024), 3000);
+    } else {
+        QMessageBox::critical(this, "Ошибка",
+            QString("Не удалось сохранить файл %1\n%2").arg(result.path, result.error));
+    }
+}
+
+void ScreenshotTool::onSavePendingChanged(int count)
+{
+    saveProgress->setVisible(count > 0);
+    saveProgress->setFormat(QString("Сохранение: %1").arg(count));
+}
+
 void ScreenshotTool::onCopy()
 {
+    takeEditorImage();
     if (currentScreenshot.isNull()) {
         QMessageBox::warning(this, "Ошибка", "Нет скриншота для копирования");
         return;
     }
 
+    // Only advertises the formats; each one is encoded when a paste asks
+    PROFILE_SCOPE("clipboard.copy");
     QClipboard *clipboard = QApplication::clipboard();
-    clipboard->setPixmap(currentScreenshot);
+    clipboard->setMimeData(new ClipboardImageData(currentScreenshot.image()));
     statusBar()->showMessage("Скриншот скопирован в буфер обмена • Ctrl+V для вставки", 3000);
 }
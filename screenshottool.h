@@ -8,10 +8,19 @@
 #include <QTimer>
 #include <QShortcut>
 #include <QStackedWidget>
+#include "savequeue.h"
+#include "imagebuffer.h"
+#include "imagepyramid.h"
+#include "burstcapture.h"
+#include "capturestore.h"
 
 class RegionSelector;
 class QPushButton;
+class QProgressBar;
+class QSpinBox;
+class QCheckBox;
 class ImageEditor;
+class HistoryStore;
 
 class ScreenshotTool : public QMainWindow
 {
@@ -21,34 +30,72 @@ public:
     explicit ScreenshotTool(QWidget *parent = nullptr);
     ~ScreenshotTool() override;
 
+    // Startup benchmark hook (startupbench): quit as soon as the first
+    // preview is painted. Call before show().
+    void setExitAfterFirstPreview(bool exit);
+
 private slots:
     void onFullScreenshot();
     void onRegionScreenshot();
-    void onRegionSelected(const QPixmap &pixmap);
+    void onRegionSelected(const ImageBuffer &image);
     void onRegionCancelled();
     void onSave();
     void onCopy();
     void onEdit();
     void onThemeChanged(int index);
-    void onImageEdited(const QPixmap &editedImage);
+    void onImageEdited(const ImageBuffer &editedImage);
+    void onSaveFinished(const SaveResult &result);
+    void onSavePendingChanged(int count);
+    void onDumpProfile();
+    void onBurst();
+    void onBurstFinished(const BurstCapture::Stats &stats);
+    void onHistoryBack();
+    void onHistoryForward();
+    void onHistoryGallery();
+
+protected:
+    void resizeEvent(QResizeEvent *event) override;
+    void showEvent(QShowEvent *event) override;
+    bool eventFilter(QObject *watched, QEvent *event) override;
 
 private:
     void setupUI();
     void setupShortcuts();
     void applyTheme(const QString &theme);
-    void setPreviewPixmap(const QPixmap &pixmap);
-    QPixmap captureFullScreen();
+    void setPreviewPixmap(const ImageBuffer &image);
+    void refreshPreview();
+    void takeEditorImage();
+    void ensureImageEditor();
+    void ensureRegionSelector();
+    void showHistoryFrame(int index);
+    QString archiveCapture();
+    ImageBuffer captureFullScreen();
 
     QLabel *previewLabel;
     QComboBox *themeComboBox;
     QPushButton *regionButton;
     QPushButton *fullButton;
     QPushButton *editButton;
-    QPixmap currentScreenshot;
+    QPushButton *burstButton;
+    QSpinBox *burstFramesSpin;
+    QSpinBox *burstRateSpin;
+    BurstCapture *burstCapture;
+    CaptureStore captureHistory;    // full-screen captures of this session
+    int historyIndex;
+    HistoryStore *historyStore;     // every capture, on disk across sessions
+    QCheckBox *skipDuplicatesCheck;
+    ImageBuffer currentScreenshot;
+    ImagePyramid previewPyramid;    // rebuilt per capture and per edit
     RegionSelector *regionSelector;
     ImageEditor *imageEditor;
     QStackedWidget *stackedWidget;
     QList<QShortcut*> shortcuts;
+    SaveQueue *saveQueue;
+    QProgressBar *saveProgress;
+    QString lastSaveFilter;
+    QLabel *profileLabel;
+    bool initialCapturePending;
+    bool exitAfterFirstPreview;
 };
 
 #endif // SCREENSHOTTOOL_H
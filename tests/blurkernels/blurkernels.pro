@@ -0,0 +1,17 @@
+include(../tests.pri)
+
+TARGET = tst_blurkernels
+TEMPLATE = app
+
+SOURCES += \
+    tst_blurkernels.cpp \
+    $$APP_ROOT/blurengine.cpp \
+    $$APP_ROOT/blurkernels.cpp \
+    $$APP_ROOT/imagebuffer.cpp \
+    $$APP_ROOT/imagepyramid.cpp
+
+HEADERS += \
+    $$APP_ROOT/blurengine.h \
+    $$APP_ROOT/blurkernels.h \
+    $$APP_ROOT/imagebuffer.h \
+    $$APP_ROOT/imagepyramid.h
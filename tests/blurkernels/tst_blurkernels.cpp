@@ -0,0 +1,177 @@
+#include "testmain.h"
+#include "blurengine.h"
+#include "blurkernels.h"
+#include <QImage>
+#include <QRandomGenerator>
+#include <QVector>
+
+// The SSE2 and AVX2 kernels must reproduce the scalar ones bit for bit:
+// directly, kernel by kernel, and through BlurEngine::blur. Widths below
+// 8 and odd sizes exercise the scalar tails of the vector loops.
+class BlurKernelsTest : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void cleanup();
+
+    void kernels_data();
+    void kernels();
+    void blur_data();
+    void blur();
+
+private:
+    static bool supported(BlurKernels::InstructionSet set);
+};
+
+namespace {
+
+const int kMaxRadius = 50;
+
+// Premultiplied pixels: no channel above alpha, as BlurEngine feeds them
+quint32 randomPixel(QRandomGenerator &random)
+{
+    const quint32 alpha = random.bounded(256);
+    quint32 pixel = alpha << 24;
+    for (int shift = 0; shift < 24; shift += 8)
+        pixel |= quint32(random.bounded(alpha + 1)) << shift;
+    return pixel;
+}
+
+QVector<quint32> randomRow(QRandomGenerator &random, int width)
+{
+    QVector<quint32> row(width);
+    for (quint32 &pixel : row)
+        pixel = randomPixel(random);
+    return row;
+}
+
+QImage randomImage(QRandomGenerator &random, int width, int height)
+{
+    QImage image(width, height, QImage::Format_ARGB32_Premultiplied);
+    for (int y = 0; y < height; ++y) {
+        quint32 *line = reinterpret_cast<quint32 *>(image.scanLine(y));
+        for (int x = 0; x < width; ++x)
+            line[x] = randomPixel(random);
+    }
+    return image;
+}
+
+} // namespace
+
+void BlurKernelsTest::cleanup()
+{
+    BlurKernels::setActiveInstructionSet(BlurKernels::detectedInstructionSet());
+}
+
+bool BlurKernelsTest::supported(BlurKernels::InstructionSet set)
+{
+    return int(set) <= int(BlurKernels::detectedInstructionSet());
+}
+
+void BlurKernelsTest::kernels_data()
+{
+    QTest::addColumn<int>("instructionSet");
+    QTest::newRow("sse2") << int(BlurKernels::InstructionSet::SSE2);
+    QTest::newRow("avx2") << int(BlurKernels::InstructionSet::AVX2);
+}
+
+// Every kernel against the scalar one for radii 1..50. The column sums
+// are built from 2 * radius + 1 real rows, so averageRow sees the same
+// range of sums as in a blur.
+void BlurKernelsTest::kernels()
+{
+    QFETCH(int, instructionSet);
+
+    const BlurKernels::InstructionSet set = BlurKernels::InstructionSet(instructionSet);
+    if (!supported(set))
+        QSKIP("Instruction set not supported by this CPU");
+
+    const BlurKernels::Kernels &scalar = BlurKernels::kernels(BlurKernels::InstructionSet::Scalar);
+    const BlurKernels::Kernels &vector = BlurKernels::kernels(set);
+    QRandomGenerator random(2);
+
+    const int widths[] = { 1, 2, 3, 4, 5, 6, 7, 8, 9, 11, 13, 15, 16, 17, 31, 33, 63, 65, 127, 1921 };
+    for (int width : widths) {
+        for (int radius = 1; radius <= kMaxRadius; ++radius) {
+            const QByteArray where = QByteArray("width ") + QByteArray::number(width)
+                + " radius " + QByteArray::number(radius);
+
+            const QVector<quint32> source = randomRow(random, width);
+            QVector<quint32> expected(width);
+            QVector<quint32> actual(width);
+            scalar.horizontalRow(source.constData(), expected.data(), width, radius);
+            vector.horizontalRow(source.constData(), actual.data(), width, radius);
+            QVERIFY2(actual == expected, ("horizontalRow, " + where).constData());
+
+            QVector<quint32> expectedSums(width * 4, 0);
+            QVector<quint32> actualSums(width * 4, 0);
+            const int count = 2 * radius + 1;
+            for (int i = 0; i < count; ++i) {
+                const QVector<quint32> row = i == 0 ? source : randomRow(random, width);
+                scalar.addRow(expectedSums.data(), row.constData(), width);
+                vector.addRow(actualSums.data(), row.constData(), width);
+            }
+            QVERIFY2(actualSums == expectedSums, ("addRow, " + where).constData());
+
+            const quint32 recip = BlurKernels::reciprocal(count);
+            scalar.averageRow(expectedSums.constData(), expected.data(), width, recip);
+            vector.averageRow(actualSums.constData(), actual.data(), width, recip);
+            QVERIFY2(actual == expected, ("averageRow, " + where).constData());
+
+            scalar.subtractRow(expectedSums.data(), source.constData(), width);
+            vector.subtractRow(actualSums.data(), source.constData(), width);
+            QVERIFY2(actualSums == expectedSums, ("subtractRow, " + where).constData());
+
+            const quint32 edgeRecip = BlurKernels::reciprocal(count - 1);
+            scalar.averageRow(expectedSums.constData(), expected.data(), width, edgeRecip);
+            vector.averageRow(actualSums.constData(), actual.data(), width, edgeRecip);
+            QVERIFY2(actual == expected, ("averageRow after subtractRow, " + where).constData());
+        }
+    }
+}
+
+void BlurKernelsTest::blur_data()
+{
+    QTest::addColumn<int>("instructionSet");
+    QTest::addColumn<int>("quality");
+
+    QTest::newRow("sse2 box") << int(BlurKernels::InstructionSet::SSE2) << int(BlurEngine::Quality::Box);
+    QTest::newRow("sse2 gaussian") << int(BlurKernels::InstructionSet::SSE2) << int(BlurEngine::Quality::Gaussian);
+    QTest::newRow("avx2 box") << int(BlurKernels::InstructionSet::AVX2) << int(BlurEngine::Quality::Box);
+    QTest::newRow("avx2 gaussian") << int(BlurKernels::InstructionSet::AVX2) << int(BlurEngine::Quality::Gaussian);
+}
+
+// Whole images, with radii both below and above the image size
+void BlurKernelsTest::blur()
+{
+    QFETCH(int, instructionSet);
+    QFETCH(int, quality);
+
+    const BlurKernels::InstructionSet set = BlurKernels::InstructionSet(instructionSet);
+    if (!supported(set))
+        QSKIP("Instruction set not supported by this CPU");
+
+    QRandomGenerator random(3);
+    const QSize sizes[] = { QSize(1, 1), QSize(7, 5), QSize(3, 41), QSize(13, 9), QSize(33, 17), QSize(101, 67) };
+    for (const QSize &size : sizes) {
+        const QImage source = randomImage(random, size.width(), size.height());
+        for (int radius = 1; radius <= kMaxRadius; ++radius) {
+            BlurKernels::setActiveInstructionSet(BlurKernels::InstructionSet::Scalar);
+            QImage expected = source;
+            BlurEngine::blur(expected, radius, BlurEngine::Quality(quality));
+
+            BlurKernels::setActiveInstructionSet(set);
+            QImage actual = source;
+            BlurEngine::blur(actual, radius, BlurEngine::Quality(quality));
+
+            const QByteArray where = QByteArray::number(size.width()) + "x"
+                + QByteArray::number(size.height()) + " radius " + QByteArray::number(radius);
+            QVERIFY2(actual == expected, where.constData());
+        }
+    }
+}
+
+TEST_MAIN(BlurKernelsTest)
+
+#include "tst_blurkernels.moc"
@@ -0,0 +1,11 @@
+include(../tests.pri)
+
+TARGET = tst_capturestore
+TEMPLATE = app
+
+SOURCES += \
+    tst_capturestore.cpp \
+    $$APP_ROOT/capturestore.cpp
+
+HEADERS += \
+    $$APP_ROOT/capturestore.h
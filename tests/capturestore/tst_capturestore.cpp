@@ -0,0 +1,174 @@
+#include "testmain.h"
+#include "testimages.h"
+#include "capturestore.h"
+#include <QPainter>
+
+// CaptureStore must rebuild every frame exactly and pick keyframes by its
+// documented rules; sizes that are not multiples of the tile size cover
+// the partial tiles at the right and bottom edges.
+class CaptureStoreTest : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void roundTrip_data();
+    void roundTrip();
+    void keyframeRules();
+    void dropOldestKeyframe();
+    void hashTile();
+};
+
+namespace {
+
+// Consecutive captures of one desktop: a small change every frame, a large
+// one every seventh frame
+QVector<QImage> sequence(const QSize &size, int frames)
+{
+    const QImage base = TestImages::pattern(size.width(), size.height());
+    QVector<QImage> result;
+    for (int i = 0; i < frames; ++i) {
+        QImage frame = base.copy();
+        QPainter painter(&frame);
+        painter.fillRect(QRect(size.width() - 20, size.height() - 9, 19, 8), QColor(i * 9, 0, 0));
+        if (i % 7 == 6)
+            painter.fillRect(QRect(0, 0, size.width() * 3 / 4, size.height() * 3 / 4), QColor(0, i * 5, 90));
+        painter.end();
+        result.append(frame);
+    }
+    return result;
+}
+
+} // namespace
+
+void CaptureStoreTest::roundTrip_data()
+{
+    QTest::addColumn<QSize>("size");
+    QTest::addColumn<int>("interval");
+
+    QTest::newRow("one tile") << QSize(40, 30) << CaptureStore::DefaultKeyframeInterval;
+    QTest::newRow("partial edge tiles") << QSize(333, 201) << CaptureStore::DefaultKeyframeInterval;
+    QTest::newRow("exact tiles, short interval") << QSize(256, 128) << 4;
+}
+
+void CaptureStoreTest::roundTrip()
+{
+    QFETCH(QSize, size);
+    QFETCH(int, interval);
+
+    const QVector<QImage> frames = sequence(size, 40);
+    CaptureStore store(interval);
+    for (int i = 0; i < frames.size(); ++i)
+        QCOMPARE(store.append(frames.at(i)), i);
+
+    QCOMPARE(store.count(), frames.size());
+    for (int i = 0; i < frames.size(); ++i)
+        QCOMPARE(store.frame(i), frames.at(i));
+    QVERIFY(store.frame(frames.size()).isNull());
+
+    int keyframes = 0;
+    for (int i = 0; i < frames.size(); ++i)
+        keyframes += store.isKeyframe(i) ? 1 : 0;
+    const CaptureStore::Stats stats = store.stats();
+    QCOMPARE(stats.frames, frames.size());
+    QCOMPARE(stats.keyframes, keyframes);
+    QCOMPARE(store.memoryUsage(), stats.storedBytes);
+
+    store.clear();
+    QCOMPARE(store.count(), 0);
+    QCOMPARE(store.memoryUsage(), qint64(0));
+}
+
+void CaptureStoreTest::keyframeRules()
+{
+    const QImage base = TestImages::pattern(256, 256);     // 16 tiles
+    CaptureStore store(3);
+
+    QVERIFY(store.isKeyframe(store.append(base)));
+    QCOMPARE(store.storedTiles(0), 16);
+
+    // One changed pixel stores one tile
+    QImage changed = base.copy();
+    changed.setPixel(100, 100, qRgb(1, 2, 3));
+    const int delta = store.append(changed);
+    QVERIFY(!store.isKeyframe(delta));
+    QCOMPARE(store.storedTiles(delta), 1);
+
+    // An unchanged frame stores nothing
+    QCOMPARE(store.storedTiles(store.append(base)), 0);
+
+    // Interval reached
+    QVERIFY(store.isKeyframe(store.append(base)));
+
+    // More than half of the tiles changed
+    QImage most = base.copy();
+    most.fill(Qt::black);
+    QVERIFY(store.isKeyframe(store.append(most)));
+
+    // Size changed
+    QVERIFY(store.isKeyframe(store.append(base.copy(0, 0, 200, 200))));
+
+    // Other formats are stored as RGB32
+    const int converted = store.append(base.convertToFormat(QImage::Format_ARGB32_Premultiplied));
+    QCOMPARE(store.frame(converted), base);
+}
+
+// The bounded session history evicts one keyframe group at a time
+void CaptureStoreTest::dropOldestKeyframe()
+{
+    const QVector<QImage> frames = sequence(QSize(200, 130), 7);
+    CaptureStore store(3);
+    for (const QImage &frame : frames)
+        store.append(frame);
+    QVERIFY(store.isKeyframe(3) && store.isKeyframe(6));
+
+    const qint64 before = store.memoryUsage();
+    QCOMPARE(store.dropOldestKeyframe(), 3);
+    QCOMPARE(store.count(), 4);
+    QVERIFY(store.memoryUsage() < before);
+    QVERIFY(store.isKeyframe(0) && store.isKeyframe(3));
+    for (int i = 0; i < store.count(); ++i)
+        QCOMPARE(store.frame(i), frames.at(i + 3));
+
+    // New deltas still refer to the latest keyframe
+    QImage changed = frames.at(6).copy();
+    changed.setPixel(5, 5, qRgb(1, 2, 3));
+    const int appended = store.append(changed);
+    QCOMPARE(appended, 4);
+    QVERIFY(!store.isKeyframe(appended));
+    QCOMPARE(store.storedTiles(appended), 1);
+    QCOMPARE(store.frame(appended), changed);
+
+    QCOMPARE(store.dropOldestKeyframe(), 3);
+    QCOMPARE(store.dropOldestKeyframe(), 2);
+    QCOMPARE(store.count(), 0);
+    QCOMPARE(store.memoryUsage(), qint64(0));
+    QCOMPARE(store.dropOldestKeyframe(), 0);
+    QVERIFY(store.isKeyframe(store.append(changed)));
+}
+
+void CaptureStoreTest::hashTile()
+{
+    const QImage image = TestImages::pattern(67, 67);
+    const quint64 hash = CaptureStore::hashTile(image.constBits(), image.bytesPerLine(), 67, 67);
+
+    // Same pixels with another stride hash the same
+    QImage padded(80, 67, QImage::Format_RGB32);
+    for (int y = 0; y < 67; ++y)
+        memcpy(padded.scanLine(y), image.constScanLine(y), 67 * 4);
+    QCOMPARE(CaptureStore::hashTile(padded.constBits(), padded.bytesPerLine(), 67, 67), hash);
+
+    // Any single pixel, the tail pixels included, changes the hash
+    const QPoint points[] = { QPoint(0, 0), QPoint(63, 10), QPoint(66, 66), QPoint(65, 40) };
+    for (const QPoint &point : points) {
+        QImage other = image.copy();
+        other.setPixel(point, other.pixel(point) ^ 0x00000100u);
+        QVERIFY(CaptureStore::hashTile(other.constBits(), other.bytesPerLine(), 67, 67) != hash);
+    }
+
+    // A tile one row shorter hashes differently
+    QVERIFY(CaptureStore::hashTile(image.constBits(), image.bytesPerLine(), 67, 66) != hash);
+}
+
+TEST_MAIN(CaptureStoreTest)
+
+#include "tst_capturestore.moc"
@@ -0,0 +1,19 @@
+include(../tests.pri)
+
+TARGET = tst_codecs
+TEMPLATE = app
+
+# zlib для pngencoder.cpp, как в ScreenshotTool.pro
+win32: QT += zlib-private
+else: LIBS += -lz
+
+SOURCES += \
+    tst_codecs.cpp \
+    $$APP_ROOT/pngencoder.cpp \
+    $$APP_ROOT/qoicodec.cpp \
+    $$APP_ROOT/profiler.cpp
+
+HEADERS += \
+    $$APP_ROOT/pngencoder.h \
+    $$APP_ROOT/qoicodec.h \
+    $$APP_ROOT/profiler.h
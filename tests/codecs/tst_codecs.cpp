@@ -0,0 +1,157 @@
+#include "testmain.h"
+#include "testimages.h"
+#include "pngencoder.h"
+#include "qoicodec.h"
+#include <QBuffer>
+
+// Lossless round trips of the application's own encoders: QoiCodec in both
+// directions, PngEncoder against Qt's PNG reader.
+class CodecsTest : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void qoiRoundTrip_data();
+    void qoiRoundTrip();
+    void qoiRejectsBadInput();
+    void qoiOpaqueAlpha();
+    void pngRoundTrip_data();
+    void pngRoundTrip();
+    void pngLevelForQuality();
+};
+
+namespace {
+
+void addSizeRows()
+{
+    QTest::addColumn<QSize>("size");
+    QTest::addColumn<bool>("alpha");
+
+    const QSize sizes[] = { QSize(1, 1), QSize(7, 3), QSize(64, 64), QSize(333, 101), QSize(1024, 301) };
+    for (const QSize &size : sizes) {
+        QTest::addRow("%dx%d rgb", size.width(), size.height()) << size << false;
+        QTest::addRow("%dx%d alpha", size.width(), size.height()) << size << true;
+    }
+}
+
+} // namespace
+
+void CodecsTest::qoiRoundTrip_data()
+{
+    addSizeRows();
+}
+
+void CodecsTest::qoiRoundTrip()
+{
+    QFETCH(QSize, size);
+    QFETCH(bool, alpha);
+
+    const QImage source = TestImages::pattern(size.width(), size.height(), alpha);
+    QByteArray encoded;
+    QBuffer output(&encoded);
+    output.open(QIODevice::WriteOnly);
+    QString error;
+    QVERIFY2(QoiCodec::write(source, &output, &error), qPrintable(error));
+    QVERIFY(QoiCodec::canRead(encoded));
+    QCOMPARE(quint8(encoded.at(12)), quint8(alpha ? 4 : 3));
+
+    QBuffer input(&encoded);
+    input.open(QIODevice::ReadOnly);
+    const QImage decoded = QoiCodec::read(&input, &error);
+    QVERIFY2(!decoded.isNull(), qPrintable(error));
+    QCOMPARE(decoded.format(), source.format());
+    QCOMPARE(decoded, source);
+}
+
+void CodecsTest::qoiRejectsBadInput()
+{
+    QString error;
+    QByteArray encoded;
+    QBuffer output(&encoded);
+    output.open(QIODevice::WriteOnly);
+    QVERIFY(!QoiCodec::write(QImage(), &output, &error));
+    QVERIFY(!error.isEmpty());
+
+    QVERIFY(QoiCodec::write(TestImages::pattern(40, 30), &output));
+    output.close();
+
+    QByteArray truncated = encoded.left(encoded.size() / 2);
+    QBuffer input(&truncated);
+    input.open(QIODevice::ReadOnly);
+    error.clear();
+    QVERIFY(QoiCodec::read(&input, &error).isNull());
+    QVERIFY(!error.isEmpty());
+
+    QByteArray notQoi("\x89PNG\r\n\x1a\n and more");
+    QVERIFY(!QoiCodec::canRead(notQoi));
+    QBuffer other(&notQoi);
+    other.open(QIODevice::ReadOnly);
+    QVERIFY(QoiCodec::read(&other).isNull());
+}
+
+// A 3-channel file may still carry alpha through QOI_OP_RGBA; the RGB32
+// image it decodes to stays opaque
+void CodecsTest::qoiOpaqueAlpha()
+{
+    QByteArray encoded("qoif", 4);
+    encoded.append(QByteArray::fromHex("00000002" "00000001" "03" "00"));
+    encoded.append(QByteArray::fromHex("ff" "102030" "80"));    // QOI_OP_RGBA, alpha 0x80
+    encoded.append(QByteArray::fromHex("c0"));                  // run of one
+    encoded.append(QByteArray::fromHex("0000000000000001"));    // end marker
+
+    QBuffer input(&encoded);
+    input.open(QIODevice::ReadOnly);
+    QString error;
+    const QImage decoded = QoiCodec::read(&input, &error);
+    QVERIFY2(!decoded.isNull(), qPrintable(error));
+    QCOMPARE(decoded.format(), QImage::Format_RGB32);
+    // Raw words: QImage::pixel() would mask the alpha byte itself
+    const QRgb *row = reinterpret_cast<const QRgb *>(decoded.constScanLine(0));
+    QCOMPARE(row[0], qRgb(0x10, 0x20, 0x30));
+    QCOMPARE(row[1], qRgb(0x10, 0x20, 0x30));
+}
+
+void CodecsTest::pngRoundTrip_data()
+{
+    addSizeRows();
+}
+
+// Several strips per image (4 threads) and a single one, at every level
+// the save dialog offers
+void CodecsTest::pngRoundTrip()
+{
+    QFETCH(QSize, size);
+    QFETCH(bool, alpha);
+
+    const QImage source = TestImages::pattern(size.width(), size.height(), alpha);
+    const int levels[] = { PngEncoder::FastestLevel, PngEncoder::DefaultLevel, PngEncoder::SmallestLevel };
+    const int threadCounts[] = { 1, 4 };
+    for (int level : levels) {
+        for (int threads : threadCounts) {
+            QByteArray encoded;
+            QBuffer buffer(&encoded);
+            buffer.open(QIODevice::WriteOnly);
+            QString error;
+            QVERIFY2(PngEncoder::write(source, &buffer, level, threads, &error), qPrintable(error));
+
+            QImage decoded;
+            QVERIFY2(decoded.loadFromData(encoded, "png"),
+                     qPrintable(QString("level %1, %2 threads").arg(level).arg(threads)));
+            QCOMPARE(decoded.hasAlphaChannel(), alpha);
+            QCOMPARE(decoded.convertToFormat(source.format()), source);
+        }
+    }
+}
+
+void CodecsTest::pngLevelForQuality()
+{
+    QCOMPARE(PngEncoder::levelForQuality(-1), PngEncoder::DefaultLevel);
+    QCOMPARE(PngEncoder::levelForQuality(0), PngEncoder::SmallestLevel);
+    QCOMPARE(PngEncoder::levelForQuality(100), 0);
+    for (int level = 0; level <= 9; ++level)
+        QCOMPARE(PngEncoder::levelForQuality(100 - (level * 91 + 8) / 9), level);
+}
+
+TEST_MAIN(CodecsTest)
+
+#include "tst_codecs.moc"
@@ -0,0 +1,17 @@
+include(../tests.pri)
+
+TARGET = tst_historystore
+TEMPLATE = app
+
+SOURCES += \
+    tst_historystore.cpp \
+    $$APP_ROOT/historystore.cpp \
+    $$APP_ROOT/perceptualhash.cpp \
+    $$APP_ROOT/qoicodec.cpp \
+    $$APP_ROOT/profiler.cpp
+
+HEADERS += \
+    $$APP_ROOT/historystore.h \
+    $$APP_ROOT/perceptualhash.h \
+    $$APP_ROOT/qoicodec.h \
+    $$APP_ROOT/profiler.h
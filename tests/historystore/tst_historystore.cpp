@@ -0,0 +1,288 @@
+#include "testmain.h"
+#include "testimages.h"
+#include "historystore.h"
+#include "perceptualhash.h"
+#include <QFile>
+#include <QTemporaryDir>
+
+// HistoryStore round trips through its files, retention, recovery from
+// damaged files, and the perceptual hash it indexes captures by.
+class HistoryStoreTest : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void appendAndLoad();
+    void reopen();
+    void limits();
+    void clear();
+    void secondInstance();
+    void damagedIndex();
+    void perceptualHash();
+    void duplicateIndex();
+};
+
+namespace {
+
+// Horizontal gradient: every dHash bit is set, and mirroring clears them
+QImage gradient(int width, int height)
+{
+    QImage image(width, height, QImage::Format_RGB32);
+    for (int y = 0; y < height; ++y) {
+        QRgb *line = reinterpret_cast<QRgb *>(image.scanLine(y));
+        for (int x = 0; x < width; ++x) {
+            const int value = 255 - x * 255 / width;
+            line[x] = qRgb(value, value, value);
+        }
+    }
+    return image;
+}
+
+} // namespace
+
+void HistoryStoreTest::appendAndLoad()
+{
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    HistoryStore store(dir.path());
+    QVERIFY2(store.isOpen(), qPrintable(store.errorString()));
+
+    const QImage wide = TestImages::pattern(641, 97);
+    const QImage tiny = TestImages::pattern(5, 3, false, 2);
+    const quint64 wideId = store.append(wide, PerceptualHash::compute(wide));
+    const quint64 tinyId = store.append(tiny, 42);
+    QVERIFY(wideId != 0 && tinyId != 0 && wideId != tinyId);
+    QCOMPARE(store.count(), 2);
+
+    // Served from memory until written
+    QCOMPARE(store.load(tinyId), tiny);
+
+    store.waitForWrites();
+    QCOMPARE(store.load(wideId), wide);
+    QCOMPARE(store.load(tinyId), tiny);
+
+    const HistoryStore::Entry &entry = store.entry(store.indexOf(wideId));
+    QVERIFY(!entry.pending);
+    QCOMPARE(entry.size, wide.size());
+    QCOMPARE(entry.hash, PerceptualHash::compute(wide));
+    QCOMPARE(entry.bytes, QFile(dir.filePath(QString("%1.qoi").arg(wideId))).size());
+    QCOMPARE(store.totalBytes(), entry.bytes + store.entry(store.indexOf(tinyId)).bytes);
+
+    // Thumbnails fit the slot, keep the aspect ratio and never enlarge
+    QCOMPARE(entry.thumbnailSize, QSize(HistoryStore::ThumbnailWidth, 19));
+    QCOMPARE(store.thumbnail(store.indexOf(wideId)).size(), entry.thumbnailSize);
+    QCOMPARE(store.thumbnail(store.indexOf(tinyId)), tiny);
+
+    QString error;
+    QVERIFY(store.load(12345, &error).isNull());
+    QVERIFY(!error.isEmpty());
+}
+
+void HistoryStoreTest::reopen()
+{
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    const int captures = 70;    // more than one atlas growth step
+    QVector<quint64> ids;
+    {
+        HistoryStore store(dir.path());
+        QImage capture(320, 200, QImage::Format_RGB32);
+        for (int i = 0; i < captures; ++i) {
+            capture.fill(qRgb(i, 255 - i, 128));
+            ids.append(store.append(capture, quint64(i) << 8));
+        }
+    }
+
+    HistoryStore store(dir.path());
+    QVERIFY2(store.isOpen(), qPrintable(store.errorString()));
+    QCOMPARE(store.count(), captures);
+    for (int i = 0; i < captures; ++i) {
+        QCOMPARE(store.entry(i).id, ids.at(i));
+        QCOMPARE(store.entry(i).hash, quint64(i) << 8);
+        QCOMPARE(store.thumbnail(i).pixel(3, 3), qRgb(i, 255 - i, 128));
+    }
+    QCOMPARE(store.findDuplicate(quint64(9) << 8, QSize(320, 200)).id, ids.at(9));
+    QCOMPARE(store.findDuplicate(quint64(9) << 8, QSize(200, 320)).id, quint64(0));
+
+    // Ids keep increasing across sessions
+    QVERIFY(store.append(QImage(8, 8, QImage::Format_RGB32), 0) > ids.last());
+}
+
+void HistoryStoreTest::limits()
+{
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    {
+        HistoryStore store(dir.path());
+        const QImage capture = TestImages::pattern(100, 60);
+        QVector<quint64> ids;
+        for (int i = 0; i < 5; ++i)
+            ids.append(store.append(capture, quint64(i + 1)));
+        store.waitForWrites();
+
+        store.setLimits(3, HistoryStore::DefaultMaxBytes);
+        QCOMPARE(store.count(), 3);
+        QCOMPARE(store.entry(0).id, ids.at(2));
+        QVERIFY(!QFile::exists(dir.filePath(QString("%1.qoi").arg(ids.at(0)))));
+        QCOMPARE(store.findDuplicate(1, capture.size(), 0).id, quint64(0));
+
+        store.setLimits(3, store.entry(0).bytes);
+        QCOMPARE(store.count(), 1);
+        QCOMPARE(store.entry(0).id, ids.last());
+
+        // Freed thumbnail slots are reused
+        store.append(capture, 6);
+        store.waitForWrites();
+        QCOMPARE(store.count(), 1);
+        QVERIFY(store.entry(0).slot < 5);
+    }
+
+    HistoryStore store(dir.path());
+    QCOMPARE(store.count(), 1);
+    QCOMPARE(store.entry(0).hash, quint64(6));
+}
+
+void HistoryStoreTest::clear()
+{
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    HistoryStore store(dir.path());
+    const quint64 id = store.append(TestImages::pattern(30, 20), 1);
+    store.clear();
+    QVERIFY(store.isOpen());
+    QCOMPARE(store.count(), 0);
+    QVERIFY(!QFile::exists(dir.filePath(QString("%1.qoi").arg(id))));
+    QCOMPARE(store.findDuplicate(1, QSize(30, 20)).id, quint64(0));
+}
+
+// Two stores on one directory would hand out the same ids
+void HistoryStoreTest::secondInstance()
+{
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    {
+        HistoryStore first(dir.path());
+        QVERIFY(first.isOpen());
+        first.append(TestImages::pattern(30, 20), 1);
+
+        HistoryStore second(dir.path());
+        QVERIFY(!second.isOpen());
+        QVERIFY(!second.errorString().isEmpty());
+        QCOMPARE(second.append(TestImages::pattern(30, 20), 2), quint64(0));
+        second.clear();
+        QCOMPARE(first.count(), 1);
+    }
+
+    HistoryStore reopened(dir.path());
+    QVERIFY(reopened.isOpen());
+    QCOMPARE(reopened.count(), 1);
+}
+
+void HistoryStoreTest::damagedIndex()
+{
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    {
+        HistoryStore store(dir.path());
+        store.append(TestImages::pattern(30, 20), 1);
+        store.append(TestImages::pattern(30, 20), 2);
+    }
+
+    // A record cut short by a crash is dropped, the others are kept
+    QFile index(dir.filePath("index.bin"));
+    QVERIFY(index.open(QIODevice::Append));
+    index.write("partial");
+    index.close();
+    {
+        HistoryStore store(dir.path());
+        QVERIFY(store.isOpen());
+        QCOMPARE(store.count(), 2);
+        store.append(TestImages::pattern(30, 20), 3);
+    }
+    {
+        HistoryStore store(dir.path());
+        QCOMPARE(store.count(), 3);
+        QCOMPARE(store.entry(2).hash, quint64(3));
+    }
+
+    // Anything else starts an empty archive
+    QVERIFY(index.open(QIODevice::WriteOnly | QIODevice::Truncate));
+    index.write("not an index at all");
+    index.close();
+    HistoryStore store(dir.path());
+    QVERIFY(store.isOpen());
+    QCOMPARE(store.count(), 0);
+}
+
+// An unchanged screen with a blinking cursor stays a near-duplicate,
+// another screen does not
+void HistoryStoreTest::perceptualHash()
+{
+    QCOMPARE(PerceptualHash::compute(QImage()), quint64(0));
+    QCOMPARE(PerceptualHash::computeBits(nullptr, 0, 0, 0), quint64(0));
+
+    const QImage image = gradient(1001, 601);
+    const quint64 hash = PerceptualHash::compute(image);
+    QCOMPARE(hash, ~quint64(0));
+
+    QImage cursor = image.copy();
+    for (int y = 300; y < 316; ++y)
+        for (int x = 500; x < 502; ++x)
+            cursor.setPixel(x, y, qRgb(0, 0, 0));
+    QVERIFY(PerceptualHash::distance(hash, PerceptualHash::compute(cursor))
+            <= PerceptualHash::NearDuplicateDistance);
+
+    QVERIFY(PerceptualHash::distance(hash, PerceptualHash::compute(image.mirrored(true, false)))
+            > PerceptualHash::NearDuplicateDistance);
+
+    // Alpha is ignored; tiny images are scaled up to the grid
+    QImage alpha = image.convertToFormat(QImage::Format_ARGB32);
+    for (int y = 0; y < alpha.height(); ++y) {
+        QRgb *line = reinterpret_cast<QRgb *>(alpha.scanLine(y));
+        for (int x = 0; x < alpha.width(); ++x)
+            line[x] = (line[x] & 0x00ffffffu) | quint32((x * 13) & 0xff) << 24;
+    }
+    QCOMPARE(PerceptualHash::computeBits(alpha.constBits(), alpha.bytesPerLine(),
+                                         alpha.width(), alpha.height()), hash);
+    QCOMPARE(PerceptualHash::compute(gradient(3, 2)), quint64(0x2424242424242424ull));
+}
+
+void HistoryStoreTest::duplicateIndex()
+{
+    const QSize screen(1920, 1080);
+    DuplicateIndex index;
+    DuplicateIndex::Match match = index.nearest(0, screen);
+    QCOMPARE(match.id, quint64(0));
+    QCOMPARE(match.distance, -1);
+
+    index.insert(1, 0x0f, screen);
+    index.insert(2, 0xff, screen);
+    index.insert(3, 0x0f, screen);
+    QCOMPARE(index.count(), 3);
+
+    // Newest on ties
+    match = index.nearest(0x0f, screen);
+    QCOMPARE(match.id, quint64(3));
+    QCOMPARE(match.distance, 0);
+    QCOMPARE(index.nearest(0x1f, screen).id, quint64(3));
+    QCOMPARE(index.nearest(0x7f, screen).id, quint64(2));
+
+    // Outside 'maxDistance'
+    QCOMPARE(index.nearest(0xf0, screen, 3).id, quint64(0));
+    QCOMPARE(index.nearest(0xf0, screen, 4).id, quint64(2));
+
+    // Only captures of the same size match, however close the hash
+    index.insert(4, 0x0f, QSize(640, 360));
+    QCOMPARE(index.nearest(0x0f, screen).id, quint64(3));
+    QCOMPARE(index.nearest(0x0f, QSize(640, 360)).id, quint64(4));
+    QCOMPARE(index.nearest(0x0f, QSize(1080, 1920)).id, quint64(0));
+
+    index.remove(3);
+    QCOMPARE(index.nearest(0x0f, screen).id, quint64(1));
+    index.clear();
+    QCOMPARE(index.count(), 0);
+}
+
+TEST_MAIN(HistoryStoreTest)
+
+#include "tst_historystore.moc"
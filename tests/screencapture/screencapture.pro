@@ -0,0 +1,17 @@
+include(../tests.pri)
+
+TARGET = tst_screencapture
+TEMPLATE = app
+
+SOURCES += \
+    tst_screencapture.cpp \
+    $$APP_ROOT/capturesource.cpp \
+    $$APP_ROOT/imagebuffer.cpp \
+    $$APP_ROOT/screencapture.cpp \
+    $$APP_ROOT/profiler.cpp
+
+HEADERS += \
+    $$APP_ROOT/capturesource.h \
+    $$APP_ROOT/imagebuffer.h \
+    $$APP_ROOT/screencapture.h \
+    $$APP_ROOT/profiler.h
@@ -0,0 +1,174 @@
+#include "testmain.h"
+#include "capturesource.h"
+#include "screencapture.h"
+#include <QRegion>
+
+Q_DECLARE_METATYPE(CaptureSource::Screen)
+
+// Multi-screen composition over SyntheticCaptureSource, whose pixels
+// encode the screen and the device position: every screen at the capture
+// scale must land pixel-exact at its place, gaps between screens black.
+class ScreenCaptureTest : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void cleanup();
+
+    void composition_data();
+    void composition();
+    void area();
+    void grabInto();
+    void parseScreens();
+
+private:
+    static void verifyScreen(const QImage &capture, const QRect &captured, qreal scale,
+                             const QVector<CaptureSource::Screen> &screens, int index);
+};
+
+void ScreenCaptureTest::cleanup()
+{
+    ScreenCapture::setSource(nullptr);
+}
+
+// Compares the part of screen 'index' inside 'captured' (logical) with
+// the synthetic pattern
+void ScreenCaptureTest::verifyScreen(const QImage &capture, const QRect &captured, qreal scale,
+                                     const QVector<CaptureSource::Screen> &screens, int index)
+{
+    const QRect logical = screens.at(index).geometry.intersected(captured);
+    const QPoint screenOrigin = (logical.topLeft() - screens.at(index).geometry.topLeft()) * scale;
+    const QPoint captureOrigin = (logical.topLeft() - captured.topLeft()) * scale;
+    for (int y = 0; y < qRound(logical.height() * scale); ++y) {
+        for (int x = 0; x < qRound(logical.width() * scale); ++x) {
+            const QRgb expected = SyntheticCaptureSource::expectedPixel(
+                index, screenOrigin.x() + x, screenOrigin.y() + y);
+            if (capture.pixel(captureOrigin + QPoint(x, y)) != expected) {
+                QFAIL(qPrintable(QString("screen %1, device pixel %2,%3")
+                                     .arg(index).arg(x).arg(y)));
+            }
+        }
+    }
+}
+
+void ScreenCaptureTest::composition_data()
+{
+    QTest::addColumn<QVector<CaptureSource::Screen>>("screens");
+
+    const CaptureSource::Screen left = { "left", QRect(0, 0, 160, 90), 1.0 };
+    const CaptureSource::Screen middle = { "middle", QRect(160, 0, 160, 90), 1.0 };
+    const CaptureSource::Screen right = { "right", QRect(320, 0, 160, 90), 1.0 };
+    QTest::newRow("one screen") << QVector<CaptureSource::Screen>{ left };
+    QTest::newRow("three screens") << QVector<CaptureSource::Screen>{ left, middle, right };
+
+    // Above and to the left of the origin, with a gap below the smaller one
+    const CaptureSource::Screen above = { "above", QRect(-40, -70, 100, 70), 1.0 };
+    const CaptureSource::Screen below = { "below", QRect(0, 0, 131, 77), 1.0 };
+    QTest::newRow("negative origin") << QVector<CaptureSource::Screen>{ below, above };
+
+    // 200% next to 100% placed lower: the low-DPI screen is scaled up
+    const CaptureSource::Screen hidpi = { "hidpi", QRect(0, 0, 96, 54), 2.0 };
+    const CaptureSource::Screen lodpi = { "lodpi", QRect(96, 20, 96, 54), 1.0 };
+    QTest::newRow("mixed dpr") << QVector<CaptureSource::Screen>{ hidpi, lodpi };
+}
+
+void ScreenCaptureTest::composition()
+{
+    QFETCH(QVector<CaptureSource::Screen>, screens);
+
+    SyntheticCaptureSource source(screens);
+    ScreenCapture::setSource(&source);
+
+    const QRect geometry = ScreenCapture::virtualGeometry();
+    const qreal scale = ScreenCapture::captureScale();
+    QRect expectedGeometry;
+    qreal expectedScale = 1.0;
+    for (const CaptureSource::Screen &screen : screens) {
+        expectedGeometry |= screen.geometry;
+        expectedScale = qMax(expectedScale, screen.devicePixelRatio);
+    }
+    QCOMPARE(geometry, expectedGeometry);
+    QCOMPARE(scale, expectedScale);
+
+    const QImage capture = ScreenCapture::grab().image();
+    QCOMPARE(capture.size(), geometry.size() * scale);
+    QCOMPARE(capture.format(), QImage::Format_RGB32);
+
+    QRegion covered;
+    for (int i = 0; i < screens.size(); ++i) {
+        covered += screens.at(i).geometry;
+        if (screens.at(i).devicePixelRatio == scale)
+            verifyScreen(capture, geometry, scale, screens, i);
+    }
+
+    // Areas no screen covers are black
+    for (const QRect &gap : QRegion(geometry) - covered) {
+        const QPoint corner = (gap.topLeft() - geometry.topLeft()) * scale;
+        QCOMPARE(capture.pixel(corner), qRgb(0, 0, 0));
+    }
+}
+
+void ScreenCaptureTest::area()
+{
+    const CaptureSource::Screen left = { "left", QRect(0, 0, 160, 90), 1.0 };
+    const CaptureSource::Screen right = { "right", QRect(160, 0, 160, 90), 1.0 };
+    const QVector<CaptureSource::Screen> screens{ left, right };
+    SyntheticCaptureSource source(screens);
+    ScreenCapture::setSource(&source);
+
+    // Across the shared edge
+    const QRect across(150, 10, 21, 33);
+    const QImage capture = ScreenCapture::grab(across).image();
+    QCOMPARE(capture.size(), across.size());
+    verifyScreen(capture, across, 1.0, screens, 0);
+    verifyScreen(capture, across, 1.0, screens, 1);
+
+    // Clipped to the desktop; nothing outside it
+    QCOMPARE(ScreenCapture::grab(QRect(300, 80, 50, 50)).size(), QSize(20, 10));
+    QVERIFY(ScreenCapture::grab(QRect(400, 0, 10, 10)).isNull());
+}
+
+// The burst path: repeated captures write into the same buffer
+void ScreenCaptureTest::grabInto()
+{
+    const CaptureSource::Screen hidpi = { "hidpi", QRect(0, 0, 96, 54), 2.0 };
+    const CaptureSource::Screen lodpi = { "lodpi", QRect(96, 20, 96, 54), 1.0 };
+    SyntheticCaptureSource source(QVector<CaptureSource::Screen>{ hidpi, lodpi });
+    ScreenCapture::setSource(&source);
+
+    QImage frame(QSize(192, 74) * 2, QImage::Format_RGB32);
+    const uchar *bits = frame.constBits();
+    QVERIFY(ScreenCapture::grabInto(frame));
+    QCOMPARE(frame.constBits(), bits);
+    QCOMPARE(frame, ScreenCapture::grab().image());
+
+    // A buffer of another size is replaced
+    QImage small(10, 10, QImage::Format_RGB32);
+    QVERIFY(ScreenCapture::grabInto(small));
+    QCOMPARE(small.size(), frame.size());
+
+    // Nothing to capture: the target is left alone
+    QVERIFY(!ScreenCapture::grabInto(frame, QRect(1000, 1000, 5, 5)));
+    QCOMPARE(frame.constBits(), bits);
+}
+
+void ScreenCaptureTest::parseScreens()
+{
+    const QVector<CaptureSource::Screen> screens =
+        SyntheticCaptureSource::parseScreens("1920x1080@2, 1280x1024,800x600@1.25");
+    QCOMPARE(screens.size(), 3);
+    QCOMPARE(screens.at(0).geometry, QRect(0, 0, 1920, 1080));
+    QCOMPARE(screens.at(0).devicePixelRatio, 2.0);
+    QCOMPARE(screens.at(1).geometry, QRect(1920, 0, 1280, 1024));
+    QCOMPARE(screens.at(1).devicePixelRatio, 1.0);
+    QCOMPARE(screens.at(2).geometry, QRect(3200, 0, 800, 600));
+    QCOMPARE(screens.at(2).devicePixelRatio, 1.25);
+
+    QVERIFY(SyntheticCaptureSource::parseScreens("1920x1080,wide").isEmpty());
+    QVERIFY(SyntheticCaptureSource::parseScreens("0x1080").isEmpty());
+    QVERIFY(SyntheticCaptureSource::parseScreens("1920x1080@0").isEmpty());
+}
+
+TEST_MAIN(ScreenCaptureTest)
+
+#include "tst_screencapture.moc"
@@ -0,0 +1,37 @@
+#ifndef TESTIMAGES_H
+#define TESTIMAGES_H
+
+#include <QImage>
+#include <QRandomGenerator>
+
+namespace TestImages {
+
+// Deterministic content that reaches every path of a lossless codec:
+// flat runs in the top third, a gradient with small steps in the middle
+// and noise at the bottom. With 'alpha' the image is ARGB32 with varying,
+// non-premultiplied alpha; otherwise RGB32.
+inline QImage pattern(int width, int height, bool alpha = false, quint32 seed = 1)
+{
+    QImage image(width, height, alpha ? QImage::Format_ARGB32 : QImage::Format_RGB32);
+    QRandomGenerator random(seed);
+    for (int y = 0; y < height; ++y) {
+        QRgb *line = reinterpret_cast<QRgb *>(image.scanLine(y));
+        for (int x = 0; x < width; ++x) {
+            QRgb pixel;
+            if (y < height / 3)
+                pixel = qRgb(0x20 * (x / 16 % 8), 0x40, 0xC0);
+            else if (y < height * 2 / 3)
+                pixel = qRgb((x * 3) & 0xff, (y * 5) & 0xff, (x + y) & 0xff);
+            else
+                pixel = random.generate() | 0xff000000u;
+            if (alpha)
+                pixel = (pixel & 0x00ffffffu) | (quint32((x * 7 + y) & 0xff) << 24);
+            line[x] = pixel;
+        }
+    }
+    return image;
+}
+
+} // namespace TestImages
+
+#endif // TESTIMAGES_H
@@ -0,0 +1,19 @@
+#ifndef TESTMAIN_H
+#define TESTMAIN_H
+
+#include <QGuiApplication>
+#include <QtTest>
+
+// Runs a QtTest object headless: the offscreen platform is used unless
+// QT_QPA_PLATFORM says otherwise, so the tests need no display.
+#define TEST_MAIN(TestObject) \
+    int main(int argc, char *argv[]) \
+    { \
+        if (!qEnvironmentVariableIsSet("QT_QPA_PLATFORM")) \
+            qputenv("QT_QPA_PLATFORM", "offscreen"); \
+        QGuiApplication app(argc, argv); \
+        TestObject test; \
+        return QTest::qExec(&test, argc, argv); \
+    }
+
+#endif // TESTMAIN_H
@@ -0,0 +1,17 @@
+# Общие настройки тестов: исходники приложения берутся из корня репозитория
+
+QT += core gui concurrent testlib
+
+CONFIG += c++11 console testcase
+CONFIG -= app_bundle
+
+APP_ROOT = $$PWD/..
+INCLUDEPATH += $$APP_ROOT $$PWD
+
+HEADERS += \
+    $$PWD/testimages.h \
+    $$PWD/testmain.h
+
+win32 {
+    QMAKE_CXXFLAGS += -Wno-deprecated-copy
+}
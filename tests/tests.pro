@@ -0,0 +1,13 @@
+# Модульные тесты (QtTest): проверки корректности без замеров времени.
+# Время горячих путей меряют бенчмарки в benchmarks/.
+#
+#   qmake tests/tests.pro && make && make check
+
+TEMPLATE = subdirs
+
+SUBDIRS += \
+    blurkernels \
+    codecs \
+    capturestore \
+    historystore \
+    screencapture
@@ -0,0 +1,212 @@
+#include "undohistory.h"
+#include <algorithm>
+
+UndoHistory::UndoHistory(qint64 memoryBudget)
+    : budget(memoryBudget),
+      usage(0)
+{
+}
+
+void UndoHistory::setMemoryBudget(qint64 bytes)
+{
+    budget = bytes;
+    enforceBudget();
+}
+
+void UndoHistory::clear()
+{
+    undoSteps.clear();
+    redoSteps.clear();
+    usage = 0;
+}
+
+void UndoHistory::recordEdit(const QImage &image, const QRect &area)
+{
+    const QRect dirty = area.intersected(image.rect());
+    if (dirty.isEmpty() || image.depth() % 8 != 0)
+        return;
+
+    Step step;
+    step.kind = StepKind::Tiles;
+    step.compressed = false;
+
+    const int bytesPerPixel = image.depth() / 8;
+    const int firstColumn = dirty.left() / TileSize;
+    const int lastColumn = dirty.right() / TileSize;
+    const int firstRow = dirty.top() / TileSize;
+    const int lastRow = dirty.bottom() / TileSize;
+
+    for (int row = firstRow; row <= lastRow; ++row) {
+        for (int column = firstColumn; column <= lastColumn; ++column) {
+            Tile tile;
+            tile.rect = QRect(column * TileSize, row * TileSize, TileSize, TileSize)
+                            .intersected(image.rect());
+            tile.compressed = false;
+
+            const int rowBytes = tile.rect.width() * bytesPerPixel;
+            tile.pixels.resize(rowBytes * tile.rect.height());
+            char *out = tile.pixels.data();
+            for (int y = tile.rect.top(); y <= tile.rect.bottom(); ++y) {
+                memcpy(out, image.constScanLine(y) + tile.rect.x() * bytesPerPixel, size_t(rowBytes));
+                out += rowBytes;
+            }
+            step.tiles.append(tile);
+        }
+    }
+
+    step.bytes = stepBytes(step);
+    pushUndo(step);
+}
+
+void UndoHistory::recordReplace(const ImageBuffer &before, const AnnotationLayer &annotations)
+{
+    Step step;
+    step.kind = StepKind::Replace;
+    step.replaced = before;
+    step.annotations = annotations;
+    step.compressed = false;
+    step.bytes = stepBytes(step);
+    pushUndo(step);
+}
+
+void UndoHistory::recordAnnotations(const AnnotationLayer &before)
+{
+    Step step;
+    step.kind = StepKind::Annotations;
+    step.annotations = before;
+    step.compressed = false;
+    step.bytes = stepBytes(step);
+    pushUndo(step);
+}
+
+bool UndoHistory::undo(ImageBuffer &image, AnnotationLayer &annotations)
+{
+    if (undoSteps.isEmpty())
+        return false;
+
+    Step step = undoSteps.takeLast();
+    usage -= step.bytes;
+    swapStep(step, image, annotations);
+    usage += step.bytes;
+    redoSteps.append(step);
+    enforceBudget();
+    return true;
+}
+
+bool UndoHistory::redo(ImageBuffer &image, AnnotationLayer &annotations)
+{
+    if (redoSteps.isEmpty())
+        return false;
+
+    Step step = redoSteps.takeLast();
+    usage -= step.bytes;
+    swapStep(step, image, annotations);
+    usage += step.bytes;
+    undoSteps.append(step);
+    enforceBudget();
+    return true;
+}
+
+// Exchanges the stored pixels with the image, turning an undo step into
+// the matching redo step and back
+void UndoHistory::swapStep(Step &step, ImageBuffer &image, AnnotationLayer &annotations)
+{
+    if (step.kind == StepKind::Replace)
+        std::swap(step.replaced, image);
+    if (step.kind != StepKind::Tiles) {
+        std::swap(step.annotations, annotations);
+        step.bytes = stepBytes(step);
+        return;
+    }
+
+    QImage &pixels = image.edit();
+    uchar *bits = pixels.bits();
+    const int bytesPerLine = pixels.bytesPerLine();
+    const int bytesPerPixel = pixels.depth() / 8;
+
+    for (Tile &tile : step.tiles) {
+        if (tile.compressed) {
+            tile.pixels = qUncompress(tile.pixels);
+            tile.compressed = false;
+        }
+
+        const int rowBytes = tile.rect.width() * bytesPerPixel;
+        uchar *stored = reinterpret_cast<uchar *>(tile.pixels.data());
+        for (int y = tile.rect.top(); y <= tile.rect.bottom(); ++y) {
+            uchar *line = bits + qptrdiff(y) * bytesPerLine + tile.rect.x() * bytesPerPixel;
+            std::swap_ranges(line, line + rowBytes, stored);
+            stored += rowBytes;
+        }
+    }
+
+    step.compressed = false;
+    step.bytes = stepBytes(step);
+}
+
+void UndoHistory::compressStep(Step &step)
+{
+    for (Tile &tile : step.tiles) {
+        tile.pixels = qCompress(tile.pixels, 1);
+        tile.compressed = true;
+    }
+    step.compressed = true;
+    step.bytes = stepBytes(step);
+}
+
+qint64 UndoHistory::stepBytes(const Step &step)
+{
+    qint64 bytes = 0;
+    for (int i = 0; i < step.annotations.count(); ++i)
+        bytes += qint64(sizeof(Annotation)) + step.annotations.at(i).text.size() * 2;
+    if (step.kind == StepKind::Replace)
+        return bytes + qint64(step.replaced.width()) * step.replaced.height() * 4;
+
+    for (const Tile &tile : step.tiles)
+        bytes += tile.pixels.size();
+    return bytes;
+}
+
+void UndoHistory::pushUndo(const Step &step)
+{
+    // A new edit invalidates everything that was undone before it
+    redoSteps.clear();
+    undoSteps.append(step);
+
+    usage = 0;
+    for (const Step &s : undoSteps)
+        usage += s.bytes;
+    enforceBudget();
+}
+
+void UndoHistory::enforceBudget()
+{
+    // 1. Compress the oldest steps; the newest undo and redo steps stay raw
+    //    so that a single Ctrl+Z / Ctrl+Y never waits for zlib
+    for (int i = 0; usage > budget && i < undoSteps.size() - 1; ++i) {
+        Step &step = undoSteps[i];
+        if (step.kind != StepKind::Tiles || step.compressed)
+            continue;
+        usage -= step.bytes;
+        compressStep(step);
+        usage += step.bytes;
+    }
+    for (int i = 0; usage > budget && i < redoSteps.size() - 1; ++i) {
+        Step &step = redoSteps[i];
+        if (step.kind != StepKind::Tiles || step.compressed)
+            continue;
+        usage -= step.bytes;
+        compressStep(step);
+        usage += step.bytes;
+    }
+
+    // 2. Evict the furthest redo steps, then the oldest undo steps,
+    //    always keeping the most recent undo step
+    while (usage > budget && !redoSteps.isEmpty()) {
+        usage -= redoSteps.first().bytes;
+        redoSteps.removeFirst();
+    }
+    while (usage > budget && undoSteps.size() > 1) {
+        usage -= undoSteps.first().bytes;
+        undoSteps.removeFirst();
+    }
+}
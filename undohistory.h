@@ -0,0 +1,86 @@
+#ifndef UNDOHISTORY_H
+#define UNDOHISTORY_H
+
+#include <QByteArray>
+#include <QImage>
+#include <QList>
+#include <QRect>
+#include <QVector>
+#include "annotationlayer.h"
+#include "imagebuffer.h"
+
+// Undo/redo for ImageEditor that stores only the tiles an operation touched.
+//
+// Before an edit, recordEdit() saves the TileSize x TileSize tiles covering
+// the dirty area. Undo and redo swap those tiles with the image, so one step
+// keeps a single copy of its tiles in either direction. Geometry changes
+// (crop) are recorded as a whole ImageBuffer, which is usually a view that
+// shares pixels with the current image. Changes to the annotation layer
+// store the previous display list, which is only a few hundred bytes.
+//
+// When the history exceeds its memory budget the oldest steps are first
+// compressed and then evicted.
+class UndoHistory
+{
+public:
+    static const int TileSize = 64;
+    static const qint64 DefaultMemoryBudget = 256ll * 1024 * 1024;
+
+    explicit UndoHistory(qint64 memoryBudget = DefaultMemoryBudget);
+
+    void setMemoryBudget(qint64 bytes);
+    qint64 memoryBudget() const { return budget; }
+    qint64 memoryUsage() const { return usage; }
+
+    void clear();
+
+    // Call before modifying 'area' of 'image' (image coordinates)
+    void recordEdit(const QImage &image, const QRect &area);
+    // Call before replacing the whole image, e.g. by a crop
+    void recordReplace(const ImageBuffer &before, const AnnotationLayer &annotations);
+    // Call before adding, moving or removing annotations
+    void recordAnnotations(const AnnotationLayer &before);
+
+    bool canUndo() const { return !undoSteps.isEmpty(); }
+    bool canRedo() const { return !redoSteps.isEmpty(); }
+    int undoCount() const { return undoSteps.size(); }
+    int redoCount() const { return redoSteps.size(); }
+
+    bool undo(ImageBuffer &image, AnnotationLayer &annotations);
+    bool redo(ImageBuffer &image, AnnotationLayer &annotations);
+
+private:
+    struct Tile {
+        QRect rect;
+        QByteArray pixels;  // raw rows, or qCompress()ed if 'compressed'
+        bool compressed;
+    };
+
+    enum class StepKind {
+        Tiles,          // pixel edit
+        Replace,        // geometry change; swaps image and annotations
+        Annotations     // display list change only
+    };
+
+    struct Step {
+        StepKind kind;
+        QVector<Tile> tiles;
+        ImageBuffer replaced;       // set for Replace
+        AnnotationLayer annotations; // set for Replace and Annotations
+        bool compressed;
+        qint64 bytes;
+    };
+
+    static void swapStep(Step &step, ImageBuffer &image, AnnotationLayer &annotations);
+    static void compressStep(Step &step);
+    static qint64 stepBytes(const Step &step);
+    void pushUndo(const Step &step);
+    void enforceBudget();
+
+    QList<Step> undoSteps;  // oldest first
+    QList<Step> redoSteps;  // most recently undone last
+    qint64 budget;
+    qint64 usage;
+};
+
+#endif // UNDOHISTORY_H
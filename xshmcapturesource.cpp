@@ -0,0 +1,212 @@
+#include "xshmcapturesource.h"
+#include <QAtomicInt>
+#include <QtDebug>
+
+// Xlib defines macros (None, Bool, Status...) that clash with Qt headers,
+// so it comes last
+#include <X11/Xlib.h>
+#include <X11/Xutil.h>
+#include <X11/extensions/XShm.h>
+#include <sys/ipc.h>
+#include <sys/shm.h>
+
+namespace {
+
+enum SegmentState {
+    SegmentFree,
+    SegmentLeased,      // an image still points into it
+    SegmentOrphaned     // leased, and the source is gone; the image frees it
+};
+
+// Xlib reports protocol errors asynchronously through a process-wide
+// handler whose default exits. Installed only around our own requests.
+bool xErrorSeen = false;
+
+int recordXError(Display *, XErrorEvent *)
+{
+    xErrorSeen = true;
+    return 0;
+}
+
+inline Display *toDisplay(void *display)
+{
+    return static_cast<Display *>(display);
+}
+
+} // namespace
+
+struct XShmCaptureSource::Segment {
+    XShmSegmentInfo info;
+    size_t capacity;
+    QAtomicInt state;
+};
+
+XShmCaptureSource::XShmCaptureSource()
+    : display(nullptr),
+      root(0)
+{
+    Display *connection = XOpenDisplay(nullptr);
+    if (!connection)
+        return;
+
+    const int screen = DefaultScreen(connection);
+    Visual *visual = DefaultVisual(connection, screen);
+    const bool xrgb = DefaultDepth(connection, screen) >= 24
+                   && visual->red_mask == 0xff0000
+                   && visual->green_mask == 0xff00
+                   && visual->blue_mask == 0xff
+                   && ImageByteOrder(connection) == LSBFirst;
+    if (!XShmQueryExtension(connection) || !xrgb) {
+        XCloseDisplay(connection);
+        return;
+    }
+
+    display = connection;
+    root = RootWindow(connection, screen);
+}
+
+XShmCaptureSource::~XShmCaptureSource()
+{
+    for (Segment *segment : segments)
+        destroySegment(segment);
+    if (display)
+        XCloseDisplay(toDisplay(display));
+}
+
+// Screen layout as Qt sees it (RandR). Qt 5 keeps a screen's top-left at
+// its native position under high-DPI scaling, so root-window coordinates
+// are the logical top-left plus the device-scaled offset inside the screen.
+QVector<CaptureSource::Screen> XShmCaptureSource::screens() const
+{
+    return QtCaptureSource().screens();
+}
+
+QImage XShmCaptureSource::grabScreen(int index, const QRect &area)
+{
+    const QVector<Screen> all = screens();
+    if (!display || index < 0 || index >= all.size())
+        return QImage();
+
+    Display *connection = toDisplay(display);
+    const int screen = DefaultScreen(connection);
+    const Screen &info = all.at(index);
+    const qreal ratio = info.devicePixelRatio;
+    const int left = qRound(area.x() * ratio);
+    const int top = qRound(area.y() * ratio);
+    QRect device(info.geometry.x() + left, info.geometry.y() + top,
+                 qRound((area.x() + area.width()) * ratio) - left,
+                 qRound((area.y() + area.height()) * ratio) - top);
+
+    // XShmGetImage fails with BadMatch outside the root window
+    device &= QRect(0, 0, DisplayWidth(connection, screen), DisplayHeight(connection, screen));
+    if (device.isEmpty())
+        return QImage();
+
+    XImage *image = XShmCreateImage(connection, DefaultVisual(connection, screen),
+                                    DefaultDepth(connection, screen), ZPixmap, nullptr,
+                                    nullptr, device.width(), device.height());
+    if (!image)
+        return QImage();
+    const int bytesPerLine = image->bytes_per_line;
+    const size_t bytes = size_t(bytesPerLine) * size_t(device.height());
+    const bool layoutOk = image->bits_per_pixel == 32;
+
+    Segment *segment = layoutOk ? acquireSegment(bytes) : nullptr;
+    bool ok = false;
+    if (segment) {
+        image->data = segment->info.shmaddr;
+        image->obdata = reinterpret_cast<char *>(&segment->info);
+        xErrorSeen = false;
+        XErrorHandler previous = XSetErrorHandler(recordXError);
+        ok = XShmGetImage(connection, root, image, device.x(), device.y(), AllPlanes) && !xErrorSeen;
+        XSetErrorHandler(previous);
+    }
+    // The segment is ours; XDestroyImage would free both pointers
+    image->data = nullptr;
+    image->obdata = nullptr;
+    XDestroyImage(image);
+
+    if (!ok) {
+        if (segment)
+            segment->state.storeRelease(SegmentFree);
+        return QImage();
+    }
+
+    return QImage(reinterpret_cast<uchar *>(segment->info.shmaddr),
+                  device.width(), device.height(), bytesPerLine,
+                  QImage::Format_RGB32, releaseSegment, segment);
+}
+
+// A free segment of at least 'bytes', leased to the caller. Free segments
+// that are too small are dropped; new ones are sized to the request.
+XShmCaptureSource::Segment *XShmCaptureSource::acquireSegment(size_t bytes)
+{
+    for (int i = segments.size() - 1; i >= 0; --i) {
+        Segment *segment = segments.at(i);
+        if (segment->state.loadAcquire() != SegmentFree)
+            continue;
+        if (segment->capacity >= bytes) {
+            segment->state.storeRelease(SegmentLeased);
+            return segment;
+        }
+        segments.remove(i);
+        destroySegment(segment);
+    }
+
+    Segment *segment = new Segment;
+    segment->capacity = bytes;
+    segment->info.shmid = shmget(IPC_PRIVATE, bytes, IPC_CREAT | 0600);
+    segment->info.readOnly = False;
+    if (segment->info.shmid < 0) {
+        qWarning() << "XShmCaptureSource: shmget failed for" << bytes << "bytes";
+        delete segment;
+        return nullptr;
+    }
+    segment->info.shmaddr = static_cast<char *>(shmat(segment->info.shmid, nullptr, 0));
+
+    Display *connection = toDisplay(display);
+    xErrorSeen = false;
+    XErrorHandler previous = XSetErrorHandler(recordXError);
+    const bool attached = segment->info.shmaddr != reinterpret_cast<char *>(-1)
+                       && XShmAttach(connection, &segment->info);
+    XSync(connection, False);
+    XSetErrorHandler(previous);
+
+    // Marked for removal right away: the kernel frees it once both this
+    // process and the server have detached, even after a crash
+    shmctl(segment->info.shmid, IPC_RMID, nullptr);
+
+    if (!attached || xErrorSeen) {
+        // Typically a remote display, which cannot map our memory
+        qWarning() << "XShmCaptureSource: XShmAttach failed";
+        if (segment->info.shmaddr != reinterpret_cast<char *>(-1))
+            shmdt(segment->info.shmaddr);
+        delete segment;
+        return nullptr;
+    }
+
+    segment->state.storeRelease(SegmentLeased);
+    segments.append(segment);
+    return segment;
+}
+
+// Detaches the server; the memory itself goes away with the last image
+void XShmCaptureSource::destroySegment(Segment *segment)
+{
+    XShmDetach(toDisplay(display), &segment->info);
+    XSync(toDisplay(display), False);
+    if (segment->state.testAndSetOrdered(SegmentLeased, SegmentOrphaned))
+        return;
+    shmdt(segment->info.shmaddr);
+    delete segment;
+}
+
+// QImage cleanup function; may run on any thread
+void XShmCaptureSource::releaseSegment(void *data)
+{
+    Segment *segment = static_cast<Segment *>(data);
+    if (segment->state.testAndSetOrdered(SegmentLeased, SegmentFree))
+        return;
+    shmdt(segment->info.shmaddr);
+    delete segment;
+}
@@ -0,0 +1,45 @@
+#ifndef XSHMCAPTURESOURCE_H
+#define XSHMCAPTURESOURCE_H
+
+#include "capturesource.h"
+
+// X11 capture through the MIT-SHM extension. The X server writes the
+// requested rectangle of the root window straight into a shared-memory
+// segment, and the returned QImage is a view of that segment: no XGetImage
+// transfer over the socket and no pixmap conversion.
+//
+// Segments are reused across captures. A segment stays leased while an
+// image (or a copy-on-write view of it) still points into it; the next
+// grab then takes another one, so a capture held by the main window and a
+// fresh one for RegionSelector alternate between two segments.
+//
+// Uses its own Display connection from the calling thread only, so grabs
+// are serialized like QtCaptureSource's. Only 32-bit TrueColor roots with
+// the usual xRGB layout are supported; isValid() is false otherwise and
+// ScreenCapture falls back to QtCaptureSource.
+class XShmCaptureSource : public CaptureSource
+{
+public:
+    XShmCaptureSource();
+    ~XShmCaptureSource() override;
+
+    bool isValid() const { return display != nullptr; }
+
+    QVector<Screen> screens() const override;
+    QImage grabScreen(int index, const QRect &area) override;
+
+private:
+    struct Segment;
+
+    Segment *acquireSegment(size_t bytes);
+    void destroySegment(Segment *segment);
+    static void releaseSegment(void *segment);
+
+    void *display;              // Display *, kept out of the header (Xlib macros)
+    unsigned long root;
+    QVector<Segment *> segments;
+
+    Q_DISABLE_COPY(XShmCaptureSource)
+};
+
+#endif // XSHMCAPTURESOURCE_H